@@ -7,6 +7,10 @@
 #include <error.h>
 #include <sched.h>
 
+// Ranks the allowed cores by speed, fastest first. The worker pool reads
+// the ranking from core_ranking.txt in the working directory of main:
+//   ./benchmark > core_ranking.txt
+
 #define NUM_ITERATIONS (1000000000)
 
 typedef struct {
@@ -15,7 +19,8 @@ typedef struct {
 } Result;
 
 int compareResults(const void *a, const void *b) {
-    return ((Result*)a)->timeSpent - ((Result*)b)->timeSpent;
+    const double difference = ((Result*)a)->timeSpent - ((Result*)b)->timeSpent;
+    return (difference > 0.0) - (difference < 0.0);
 }
 
 void __attribute__((optimize("O0"))) benchmarkCore(void) {
@@ -31,7 +36,7 @@ void __attribute__((optimize("O0"))) benchmarkCore(void) {
 }
 
 void * benchmark(void *arg) {
-    size_t coreIndex = *(int*)arg;
+    size_t coreIndex = *(size_t*)arg;
     cpu_set_t cpuSet;
     CPU_ZERO(&cpuSet);
     CPU_SET(coreIndex, &cpuSet);
@@ -56,12 +61,20 @@ void * benchmark(void *arg) {
 }
 
 int main(void) {
-    size_t coreAmount = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t allowedCpuSet;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowedCpuSet)) {
+        perror("sched_getaffinity");
+        return EXIT_FAILURE;
+    }
+    size_t coreAmount = CPU_COUNT(&allowedCpuSet);
     pthread_t threads[coreAmount];
     size_t coreIndices[coreAmount];
 
-    for (size_t i = 0; i < coreAmount; ++i) {
-        coreIndices[i] = i;
+    for (size_t i = 0, cpu = 0; i < coreAmount; ++i, ++cpu) {
+        while (!CPU_ISSET(cpu, &allowedCpuSet)) {
+            ++cpu;
+        }
+        coreIndices[i] = cpu;
         int error = pthread_create(
             &threads[i],
             NULL,
@@ -85,7 +98,7 @@ int main(void) {
         }
         results[i] = (Result){
             .timeSpent = *timeSpent,
-            .coreIndex = i
+            .coreIndex = coreIndices[i]
         };
         free(timeSpent);
     }
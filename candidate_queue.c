@@ -0,0 +1,139 @@
+#include "candidate_queue.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+
+CandidateQueue * candidateQueue_new(uint64_t capacity) {
+    DEBUG_ENTER_FUNC();
+    CandidateQueue *candidateQueue = (CandidateQueue*)malloc(
+        sizeof(CandidateQueue)
+    );
+    if (!candidateQueue) {
+        PRINT_ERROR("error while allocating candidateQueue");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    candidateQueue->entries = (CandidateQueueEntry*)malloc(
+        capacity * sizeof(CandidateQueueEntry)
+    );
+    if (!candidateQueue->entries) {
+        free(candidateQueue);
+        PRINT_ERROR("error while allocating candidateQueue->entries");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    candidateQueue->entryAmount = 0;
+    candidateQueue->capacity = capacity;
+
+    DEBUG_EXIT_FUNC();
+    return candidateQueue;
+}
+
+void candidateQueue_delete(CandidateQueue *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->entries);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void candidateQueue_clear(CandidateQueue *self) {
+    DEBUG_ENTER_FUNC();
+    self->entryAmount = 0;
+    DEBUG_EXIT_FUNC();
+}
+
+bool candidateQueue_isEmpty(const CandidateQueue *self) {
+    DEBUG_ENTER_FUNC();
+    bool result = self->entryAmount == 0;
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+bool _candidateQueue_isBefore(
+    const CandidateQueueEntry *entry1,
+    const CandidateQueueEntry *entry2
+) {
+    DEBUG_ENTER_FUNC();
+    bool result = (
+        entry1->errorDelta < entry2->errorDelta
+        || (
+            entry1->errorDelta == entry2->errorDelta
+            && entry1->pointIndex < entry2->pointIndex
+        )
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+void candidateQueue_push(
+    CandidateQueue *self,
+    int64_t errorDelta,
+    uint64_t pointIndex
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(
+        self->entryAmount < self->capacity,
+        "candidateQueue capacity exceeded."
+    );
+    const CandidateQueueEntry entry = {
+        .errorDelta = errorDelta,
+        .pointIndex = pointIndex
+    };
+    uint64_t i = self->entryAmount++;
+    while (i > 0) {
+        const uint64_t parent = (i - 1) / 2;
+        if (!_candidateQueue_isBefore(&entry, &(self->entries[parent]))) {
+            break;
+        }
+        self->entries[i] = self->entries[parent];
+        i = parent;
+    }
+    self->entries[i] = entry;
+    DEBUG_EXIT_FUNC();
+}
+
+const CandidateQueueEntry * candidateQueue_peek(const CandidateQueue *self) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(self->entryAmount > 0, "candidateQueue is empty.");
+    const CandidateQueueEntry *result = &(self->entries[0]);
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+CandidateQueueEntry candidateQueue_pop(CandidateQueue *self) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(self->entryAmount > 0, "candidateQueue is empty.");
+    const CandidateQueueEntry result = self->entries[0];
+    const CandidateQueueEntry last = self->entries[--(self->entryAmount)];
+    uint64_t i = 0;
+    while (true) {
+        uint64_t child = 2 * i + 1;
+        if (child >= self->entryAmount) {
+            break;
+        }
+        if (
+            child + 1 < self->entryAmount
+            && _candidateQueue_isBefore(
+                &(self->entries[child + 1]), &(self->entries[child])
+            )
+        ) {
+            ++child;
+        }
+        if (!_candidateQueue_isBefore(&(self->entries[child]), &last)) {
+            break;
+        }
+        self->entries[i] = self->entries[child];
+        i = child;
+    }
+    if (self->entryAmount > 0) {
+        self->entries[i] = last;
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
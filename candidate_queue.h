@@ -0,0 +1,32 @@
+#ifndef __CANDIDATE_QUEUE_H__
+#define __CANDIDATE_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    int64_t errorDelta;
+    uint64_t pointIndex;
+} CandidateQueueEntry;
+
+// binary min-heap ordered by errorDelta, ties broken by pointIndex
+typedef struct {
+    CandidateQueueEntry *entries;
+    uint64_t entryAmount;
+    uint64_t capacity;
+} CandidateQueue;
+
+CandidateQueue * candidateQueue_new(uint64_t capacity);
+void candidateQueue_delete(CandidateQueue *self);
+
+void candidateQueue_clear(CandidateQueue *self);
+bool candidateQueue_isEmpty(const CandidateQueue *self);
+void candidateQueue_push(
+    CandidateQueue *self,
+    int64_t errorDelta,
+    uint64_t pointIndex
+);
+const CandidateQueueEntry * candidateQueue_peek(const CandidateQueue *self);
+CandidateQueueEntry candidateQueue_pop(CandidateQueue *self);
+
+#endif // __CANDIDATE_QUEUE_H__
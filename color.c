@@ -10,6 +10,15 @@ uint8_t _mix(uint8_t a, uint8_t b, double t) {
     return result;
 }
 
+uint8_t _mixFixed(uint8_t a, uint8_t b, uint32_t weight) {
+    DEBUG_ENTER_FUNC();
+    uint8_t result = (uint8_t)(
+        ((uint32_t)a * (COLOR_MIX_WEIGHT_ONE - weight) + (uint32_t)b * weight) >> 16
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
 void color_mix(const Color *color1, const Color *color2, double t, Color *newColor) {
     DEBUG_ENTER_FUNC();
     DEBUG_ASSERT(0.0 <= t, "t has to be greater or equal to 0.");
@@ -49,3 +58,24 @@ uint64_t color_weightedSquaredError(const Color *color1, const Color *color2, do
     DEBUG_EXIT_FUNC();
     return result;
 }
+
+void color_mixFixed(const Color *color1, const Color *color2, uint32_t weight, Color *newColor) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(weight <= COLOR_MIX_WEIGHT_ONE, "weight has to be smaller or equal to COLOR_MIX_WEIGHT_ONE.");
+    *newColor = (Color){
+        .c = _mixFixed(color1->c, color2->c, weight),
+        .m = _mixFixed(color1->m, color2->m, weight),
+        .y = _mixFixed(color1->y, color2->y, weight),
+    };
+    DEBUG_EXIT_FUNC();
+}
+
+uint64_t color_weightedSquaredErrorFixed(const Color *color1, const Color *color2, uint64_t weight) {
+    DEBUG_ENTER_FUNC();
+    Color errorColor = COLOR_NULL;
+    color_sub(color1, color2, &errorColor);
+    const uint64_t sqrtError = color_componentSum(&errorColor);
+    uint64_t result = sqrtError * sqrtError * weight;
+    DEBUG_EXIT_FUNC();
+    return result;
+}
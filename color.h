@@ -5,6 +5,9 @@
 
 #define COLOR_NULL ((Color){ 0, 0, 0 })
 
+// fixed point mix weight that fully replaces color1 by color2
+#define COLOR_MIX_WEIGHT_ONE (1 << 16)
+
 #pragma pack(1)
 typedef struct {
     uint8_t c;
@@ -16,5 +19,7 @@ void color_mix(const Color *color1, const Color *color2, double t, Color *newCol
 void color_sub(const Color *color1, const Color *color2, Color *newColor);
 uint64_t color_componentSum(const Color *color);
 uint64_t color_weightedSquaredError(const Color *color1, const Color *color2, double weight);
+void color_mixFixed(const Color *color1, const Color *color2, uint32_t weight, Color *newColor);
+uint64_t color_weightedSquaredErrorFixed(const Color *color1, const Color *color2, uint64_t weight);
 
 #endif // __COLOR_H__
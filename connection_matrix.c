@@ -0,0 +1,99 @@
+#include "connection_matrix.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+
+#define WORD_BITS (64)
+
+ConnectionMatrix * connectionMatrix_new(uint64_t pointAmount) {
+    DEBUG_ENTER_FUNC();
+    ConnectionMatrix *connectionMatrix = (ConnectionMatrix*)malloc(
+        sizeof(ConnectionMatrix)
+    );
+    if (!connectionMatrix) {
+        PRINT_ERROR("error while allocating connectionMatrix");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    connectionMatrix->pointAmount = pointAmount;
+    connectionMatrix->wordsPerRow = (pointAmount + WORD_BITS - 1) / WORD_BITS;
+    connectionMatrix->words = (uint64_t*)calloc(
+        pointAmount * connectionMatrix->wordsPerRow, sizeof(uint64_t)
+    );
+    if (!connectionMatrix->words) {
+        free(connectionMatrix);
+        PRINT_ERROR("error while allocating connectionMatrix->words");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    DEBUG_EXIT_FUNC();
+    return connectionMatrix;
+}
+
+void connectionMatrix_delete(ConnectionMatrix *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->words);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+bool connectionMatrix_isDone(
+    const ConnectionMatrix *self,
+    uint64_t startIndex,
+    uint64_t endIndex
+) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t word = self->words[
+        startIndex * self->wordsPerRow + endIndex / WORD_BITS
+    ];
+    DEBUG_EXIT_FUNC();
+    return (word >> (endIndex % WORD_BITS)) & 1;
+}
+
+void connectionMatrix_markDone(
+    ConnectionMatrix *self,
+    uint64_t startIndex,
+    uint64_t endIndex
+) {
+    DEBUG_ENTER_FUNC();
+    self->words[startIndex * self->wordsPerRow + endIndex / WORD_BITS] |= (
+        ((uint64_t)1) << (endIndex % WORD_BITS)
+    );
+    self->words[endIndex * self->wordsPerRow + startIndex / WORD_BITS] |= (
+        ((uint64_t)1) << (startIndex % WORD_BITS)
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+uint64_t connectionMatrix_availablePartners(
+    const ConnectionMatrix *self,
+    uint64_t pointIndex,
+    uint64_t *partners
+) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t *row = self->words + pointIndex * self->wordsPerRow;
+    uint64_t partnerAmount = 0;
+    for (uint64_t w = 0; w < self->wordsPerRow; ++w) {
+        uint64_t available = ~row[w];
+        if (w == pointIndex / WORD_BITS) {
+            available &= ~(((uint64_t)1) << (pointIndex % WORD_BITS));
+        }
+        if (w == self->wordsPerRow - 1 && self->pointAmount % WORD_BITS) {
+            available &= (((uint64_t)1) << (self->pointAmount % WORD_BITS)) - 1;
+        }
+        while (available) {
+            partners[partnerAmount++] = (
+                w * WORD_BITS + (uint64_t)__builtin_ctzll(available)
+            );
+            available &= available - 1;
+        }
+    }
+    DEBUG_EXIT_FUNC();
+    return partnerAmount;
+}
@@ -0,0 +1,38 @@
+#ifndef __CONNECTION_MATRIX_H__
+#define __CONNECTION_MATRIX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Symmetric pin-to-pin "connection is done" matrix stored as one bitset
+// row per pin in a single allocation. Bit j of row i is set once the
+// connection i-j was used, so the free partners of a pin can be listed by
+// scanning the inverted words of its row with count-trailing-zeros.
+typedef struct {
+    uint64_t pointAmount;
+    uint64_t wordsPerRow;
+    uint64_t *words;
+} ConnectionMatrix;
+
+ConnectionMatrix * connectionMatrix_new(uint64_t pointAmount);
+void connectionMatrix_delete(ConnectionMatrix *self);
+
+bool connectionMatrix_isDone(
+    const ConnectionMatrix *self,
+    uint64_t startIndex,
+    uint64_t endIndex
+);
+void connectionMatrix_markDone(
+    ConnectionMatrix *self,
+    uint64_t startIndex,
+    uint64_t endIndex
+);
+// writes the partners of pointIndex whose connection is not done yet in
+// ascending order, pointIndex itself excluded, and returns their amount
+uint64_t connectionMatrix_availablePartners(
+    const ConnectionMatrix *self,
+    uint64_t pointIndex,
+    uint64_t *partners
+);
+
+#endif // __CONNECTION_MATRIX_H__
@@ -4,13 +4,17 @@ import subprocess
 import numpy as np
 from PIL import Image
 
-from shared_data import InputData, SharedData, Thread
+from shared_data import InputData, SharedData, Thread, quantize_importance
 
 
 def main():
     image_width = 256
     debug_store_images = False
     debug_store_absolute_errors = False
+    use_line_atlas = False
+    use_lazy_greedy = False
+    use_spatial_index = False
+    use_numa = False
     radius_in_micrometers = 300_000
     background_color = np.array([0, 0, 0], dtype=np.uint8)
     point_amount = 4
@@ -19,6 +23,10 @@ def main():
     max_iterations = 8
     min_relative_error = 0.0
     relative_error_streak = 0
+    beam_width = 1
+    beam_depth = 1
+    pyramid_downscale_factor = 1
+    pyramid_coarse_iteration_ratio = 0.0
     threads = [
         Thread(255, 2000, np.array([255, 0, 0], dtype=np.uint8)),
         Thread(255, 2000, np.array([0, 255, 0], dtype=np.uint8)),
@@ -27,16 +35,25 @@ def main():
     ]
     thread_order = [0, 1, 2, 3]
     start_points = [0, 0, 0, 0]
+    # None spaces the pins on a circle, otherwise an (x, y) pixel position
+    # per pin, e.g. for rectangular frames
+    pin_positions = None
     target_image = Image.open("images/input.png").resize(
         (image_width, image_width)
     )
     target = 255 - np.array(target_image)
-    importance = np.ones([image_width, image_width], dtype=np.float64)
+    importance, importance_scale = quantize_importance(
+        np.ones([image_width, image_width], dtype=np.float64)
+    )
 
     input_data = InputData(
         image_width,
         debug_store_images,
         debug_store_absolute_errors,
+        use_line_atlas,
+        use_lazy_greedy,
+        use_spatial_index,
+        use_numa,
         radius_in_micrometers,
         background_color,
         point_amount,
@@ -45,11 +62,17 @@ def main():
         max_iterations,
         min_relative_error,
         relative_error_streak,
+        beam_width,
+        beam_depth,
+        pyramid_downscale_factor,
+        pyramid_coarse_iteration_ratio,
         threads,
         thread_order,
         start_points,
         target,
-        importance
+        importance,
+        importance_scale,
+        pin_positions
     )
     shared_data = SharedData(input_data)
     output_data = shared_data.output_data
@@ -67,6 +90,10 @@ def main():
             print(f"Failed due to signal: {signal_name}")
         return
     shared_data.read()
+    print(
+        f"Last iteration ran on {output_data.worker_amount} workers with"
+        f" candidate chunks of {output_data.candidate_chunk_size}."
+    )
     instructions = output_data.instructions
     print([str(i) for i in instructions])
     result = 255 - output_data.result
@@ -0,0 +1,561 @@
+#include "line_atlas.h"
+#include "line_renderer.h"
+#include "numa_memory.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LINE_ATLAS_MAGIC (0x53414c5441454e4cull)
+#define LINE_ATLAS_VERSION (4)
+#define LINE_ATLAS_PATH_SIZE (1024)
+#define FNV_OFFSET_BASIS (0xcbf29ce484222325ull)
+#define FNV_PRIME (0x100000001b3ull)
+
+size_t _lineAtlas_offsetsOffset(uint64_t thicknessClassAmount) {
+    DEBUG_ENTER_FUNC();
+    size_t result = (
+        sizeof(LineAtlasHeader) + thicknessClassAmount * sizeof(double)
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+size_t _lineAtlas_pixelIndicesOffset(
+    uint64_t thicknessClassAmount,
+    uint64_t pairAmount
+) {
+    DEBUG_ENTER_FUNC();
+    size_t result = (
+        _lineAtlas_offsetsOffset(thicknessClassAmount)
+        + (thicknessClassAmount * pairAmount + 1) * sizeof(uint64_t)
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+size_t _lineAtlas_size(
+    uint64_t thicknessClassAmount,
+    uint64_t pairAmount,
+    uint64_t pixelAmount
+) {
+    DEBUG_ENTER_FUNC();
+    size_t result = (
+        _lineAtlas_pixelIndicesOffset(thicknessClassAmount, pairAmount)
+        + pixelAmount * sizeof(uint32_t)
+        + pixelAmount * sizeof(uint8_t)
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+void _lineAtlas_layout(LineAtlas *self, void *mapping, size_t mappingSize) {
+    DEBUG_ENTER_FUNC();
+    uint8_t *memory = (uint8_t*)mapping;
+    self->mapping = mapping;
+    self->mappingSize = mappingSize;
+    self->header = (const LineAtlasHeader*)memory;
+
+    const uint64_t thicknessClassAmount = self->header->thicknessClassAmount;
+    const uint64_t pairAmount = indexer_pairAmount(&(self->indexer));
+
+    self->thicknessesInPixels = (const double*)(
+        memory + sizeof(LineAtlasHeader)
+    );
+    self->offsets = (const uint64_t*)(
+        memory + _lineAtlas_offsetsOffset(thicknessClassAmount)
+    );
+    self->pixelIndices = (const uint32_t*)(
+        memory + _lineAtlas_pixelIndicesOffset(thicknessClassAmount, pairAmount)
+    );
+    self->coverages = (const uint8_t*)(
+        self->pixelIndices + self->header->pixelAmount
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+void _lineAtlas_path(
+    char *buffer,
+    size_t bufferSize,
+    uint64_t imageWidth,
+    const PinTable *pinTable,
+    const double *thicknessClasses,
+    uint64_t thicknessClassAmount
+) {
+    DEBUG_ENTER_FUNC();
+    // the pin layout is part of the key, custom layouts with the same pin
+    // amount must not share an atlas
+    uint64_t hash = FNV_OFFSET_BASIS;
+    const uint8_t *bytes = (const uint8_t*)thicknessClasses;
+    for (size_t i = 0; i < thicknessClassAmount * sizeof(double); ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    hash ^= (uint64_t)pinTable->isCircular;
+    hash *= FNV_PRIME;
+    const double *positions[] = { pinTable->x, pinTable->y };
+    for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); ++p) {
+        bytes = (const uint8_t*)positions[p];
+        for (size_t i = 0; i < pinTable->pointAmount * sizeof(double); ++i) {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+    }
+    snprintf(
+        buffer,
+        bufferSize,
+        "%s/line_atlas_%ld_%ld_%016lx.bin",
+        LINE_ATLAS_DIRECTORY,
+        imageWidth,
+        pinTable->pointAmount,
+        hash
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+bool _lineAtlas_open(
+    LineAtlas *self,
+    const char *path,
+    uint64_t imageWidth,
+    const double *thicknessClasses,
+    uint64_t thicknessClassAmount
+) {
+    DEBUG_ENTER_FUNC();
+    int fileDescriptor = open(path, O_RDONLY);
+    if (fileDescriptor == -1) {
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (
+        fstat(fileDescriptor, &fileStatus) == -1
+        || (size_t)fileStatus.st_size < sizeof(LineAtlasHeader)
+    ) {
+        close(fileDescriptor);
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    const size_t mappingSize = (size_t)fileStatus.st_size;
+    void *mapping = mmap(
+        NULL, mappingSize, PROT_READ, MAP_SHARED, fileDescriptor, 0
+    );
+    close(fileDescriptor);
+    if (mapping == MAP_FAILED) {
+        PRINT_ERROR("error while mapping line atlas");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    const LineAtlasHeader *header = (const LineAtlasHeader*)mapping;
+    const uint64_t pairAmount = indexer_pairAmount(&(self->indexer));
+    const bool isValid = (
+        header->magic == LINE_ATLAS_MAGIC
+        && header->version == LINE_ATLAS_VERSION
+        && header->imageWidth == imageWidth
+        && header->pointAmount == self->indexer.pointAmount
+        && header->thicknessClassAmount == thicknessClassAmount
+        && mappingSize == _lineAtlas_size(
+            thicknessClassAmount, pairAmount, header->pixelAmount
+        )
+        && memcmp(
+            (const uint8_t*)mapping + sizeof(LineAtlasHeader),
+            thicknessClasses,
+            thicknessClassAmount * sizeof(double)
+        ) == 0
+    );
+    if (!isValid) {
+        munmap(mapping, mappingSize);
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    _lineAtlas_layout(self, mapping, mappingSize);
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+bool _lineAtlas_rasterize(
+    LineAtlas *self,
+    uint64_t imageWidth,
+    const PinTable *pinTable,
+    const double *thicknessClasses,
+    uint64_t thicknessClassAmount,
+    uint64_t *offsets,
+    uint32_t *pixelIndices,
+    uint8_t *coverages
+) {
+    DEBUG_ENTER_FUNC();
+    LineRenderer *lineRenderer = lineRenderer_new();
+    if (!lineRenderer) {
+        PRINT_ERROR("error while constructing lineRenderer");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    if (!lineRenderer_setClipRegion(
+        lineRenderer, imageWidth, pinTable->isCircular
+    )) {
+        lineRenderer_delete(lineRenderer);
+        PRINT_ERROR("error while setting the clip region of lineRenderer");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    const uint64_t maxSpanAmount = lineRenderer_maxSpanAmount(imageWidth);
+    LineSpan *spans = (LineSpan*)malloc(
+        LINE_RENDERER_FAN_SIZE * maxSpanAmount * sizeof(LineSpan)
+    );
+    if (!spans) {
+        lineRenderer_delete(lineRenderer);
+        PRINT_ERROR("error while allocating spans");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    const uint64_t pointAmount = self->indexer.pointAmount;
+    uint64_t lineIndex = 0;
+    uint64_t pixelAmount = 0;
+    for (uint64_t t = 0; t < thicknessClassAmount; ++t) {
+        for (uint64_t i = 0; i < pointAmount; ++i) {
+            double x0 = 0.0;
+            double y0 = 0.0;
+            pinTable_position(pinTable, i, &x0, &y0);
+            // the lines of pin i to all later pins are rasterized as fans
+            for (uint64_t j = i + 1; j < pointAmount; j += LINE_RENDERER_FAN_SIZE) {
+                const uint64_t fanSize = (
+                    pointAmount - j < LINE_RENDERER_FAN_SIZE
+                    ? pointAmount - j
+                    : LINE_RENDERER_FAN_SIZE
+                );
+                double x1[LINE_RENDERER_FAN_SIZE];
+                double y1[LINE_RENDERER_FAN_SIZE];
+                uint64_t spanAmounts[LINE_RENDERER_FAN_SIZE];
+                for (uint64_t k = 0; k < fanSize; ++k) {
+                    pinTable_position(pinTable, j + k, &(x1[k]), &(y1[k]));
+                }
+                lineRenderer_drawSpanFan(
+                    lineRenderer, x0, y0, x1, y1, fanSize, thicknessClasses[t],
+                    spans, maxSpanAmount, spanAmounts
+                );
+                for (uint64_t k = 0; k < fanSize; ++k) {
+                    offsets[lineIndex++] = pixelAmount;
+                    // the first pass only counts, the second one fills the
+                    // sections
+                    pixelAmount += lineRenderer_expandSpans(
+                        spans + k * maxSpanAmount, spanAmounts[k],
+                        pixelIndices ? pixelIndices + pixelAmount : NULL,
+                        coverages ? coverages + pixelAmount : NULL
+                    );
+                }
+            }
+        }
+    }
+    offsets[lineIndex] = pixelAmount;
+
+    free(spans);
+    lineRenderer_delete(lineRenderer);
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+bool _lineAtlas_build(
+    LineAtlas *self,
+    const char *path,
+    uint64_t imageWidth,
+    const PinTable *pinTable,
+    const double *thicknessClasses,
+    uint64_t thicknessClassAmount
+) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t pairAmount = indexer_pairAmount(&(self->indexer));
+    const uint64_t lineAmount = thicknessClassAmount * pairAmount;
+
+    uint64_t *offsets = (uint64_t*)malloc((lineAmount + 1) * sizeof(uint64_t));
+    if (!offsets) {
+        PRINT_ERROR("error while allocating offsets");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    if (!_lineAtlas_rasterize(
+        self, imageWidth, pinTable, thicknessClasses, thicknessClassAmount,
+        offsets, NULL, NULL
+    )) {
+        free(offsets);
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    const uint64_t pixelAmount = offsets[lineAmount];
+    const size_t mappingSize = _lineAtlas_size(
+        thicknessClassAmount, pairAmount, pixelAmount
+    );
+    if (mappingSize > LINE_ATLAS_MAX_SIZE) {
+        char buffer[256];
+        snprintf(
+            buffer,
+            sizeof(buffer),
+            "line atlas of %ld bytes exceeds LINE_ATLAS_MAX_SIZE",
+            mappingSize
+        );
+        errno = EFBIG;
+        PRINT_ERROR(buffer);
+        free(offsets);
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    // build into a temporary file that is renamed when complete, so that
+    // concurrent jobs never map a partially written atlas
+    char temporaryPath[LINE_ATLAS_PATH_SIZE];
+    snprintf(
+        temporaryPath, sizeof(temporaryPath), "%s.%d.tmp", path, getpid()
+    );
+    mkdir(LINE_ATLAS_DIRECTORY, 0755);
+    int fileDescriptor = open(temporaryPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor != -1 && ftruncate(fileDescriptor, mappingSize) == -1) {
+        close(fileDescriptor);
+        unlink(temporaryPath);
+        fileDescriptor = -1;
+    }
+
+    void *mapping = MAP_FAILED;
+    if (fileDescriptor != -1) {
+        mapping = mmap(
+            NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fileDescriptor, 0
+        );
+    }
+    if (mapping == MAP_FAILED) {
+        PRINT_ERROR("error while creating line atlas file, keeping it in memory");
+        if (fileDescriptor != -1) {
+            close(fileDescriptor);
+            unlink(temporaryPath);
+            fileDescriptor = -1;
+        }
+        mapping = mmap(
+            NULL, mappingSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+        );
+        if (mapping == MAP_FAILED) {
+            PRINT_ERROR("error while allocating line atlas");
+            free(offsets);
+            DEBUG_EXIT_FUNC();
+            return false;
+        }
+    }
+
+    *(LineAtlasHeader*)mapping = (LineAtlasHeader){
+        .magic = LINE_ATLAS_MAGIC,
+        .version = LINE_ATLAS_VERSION,
+        .imageWidth = imageWidth,
+        .pointAmount = self->indexer.pointAmount,
+        .thicknessClassAmount = thicknessClassAmount,
+        .pixelAmount = pixelAmount
+    };
+    _lineAtlas_layout(self, mapping, mappingSize);
+    memcpy(
+        (void*)self->thicknessesInPixels,
+        (void*)thicknessClasses,
+        thicknessClassAmount * sizeof(double)
+    );
+    free(offsets);
+
+    // an incomplete atlas must never be renamed into the cache, later jobs
+    // would load it
+    if (
+        !_lineAtlas_rasterize(
+            self, imageWidth, pinTable, thicknessClasses, thicknessClassAmount,
+            (uint64_t*)self->offsets,
+            (uint32_t*)self->pixelIndices,
+            (uint8_t*)self->coverages
+        )
+        || self->offsets[lineAmount] != pixelAmount
+    ) {
+        PRINT_ERROR("error while filling line atlas");
+        munmap(mapping, mappingSize);
+        self->mapping = NULL;
+        if (fileDescriptor != -1) {
+            close(fileDescriptor);
+            unlink(temporaryPath);
+        }
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    if (mprotect(mapping, mappingSize, PROT_READ) == -1) {
+        PRINT_ERROR("error while protecting line atlas, keeping it writable");
+    }
+
+    if (fileDescriptor != -1) {
+        close(fileDescriptor);
+        if (rename(temporaryPath, path) == -1) {
+            PRINT_ERROR("error while storing line atlas");
+            unlink(temporaryPath);
+        }
+    }
+
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+LineAtlas * lineAtlas_new(
+    uint64_t imageWidth,
+    const Indexer *indexer,
+    const PinTable *pinTable,
+    const double *thicknessesInPixels,
+    uint64_t thicknessAmount
+) {
+    DEBUG_ENTER_FUNC();
+    if (imageWidth * imageWidth > UINT32_MAX) {
+        errno = EINVAL;
+        PRINT_ERROR("image too large for 32 bit line atlas pixel indices");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    LineAtlas *lineAtlas = (LineAtlas*)calloc(1, sizeof(LineAtlas));
+    if (!lineAtlas) {
+        PRINT_ERROR("error while allocating lineAtlas");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    lineAtlas->indexer = *indexer;
+
+    double *thicknessClasses = (double*)malloc(thicknessAmount * sizeof(double));
+    if (!thicknessClasses) {
+        PRINT_ERROR("error while allocating thicknessClasses");
+        free(lineAtlas);
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    uint64_t thicknessClassAmount = 0;
+    for (uint64_t i = 0; i < thicknessAmount; ++i) {
+        bool isKnown = false;
+        for (uint64_t j = 0; j < thicknessClassAmount; ++j) {
+            isKnown |= (thicknessClasses[j] == thicknessesInPixels[i]);
+        }
+        if (!isKnown) {
+            thicknessClasses[thicknessClassAmount++] = thicknessesInPixels[i];
+        }
+    }
+
+    char path[LINE_ATLAS_PATH_SIZE];
+    _lineAtlas_path(
+        path, sizeof(path), imageWidth, pinTable,
+        thicknessClasses, thicknessClassAmount
+    );
+
+    bool success = _lineAtlas_open(
+        lineAtlas, path, imageWidth, thicknessClasses, thicknessClassAmount
+    );
+    if (success) {
+        DEBUG_PRINT("loaded line atlas %s\n", path);
+    } else {
+        DEBUG_PRINT("building line atlas %s\n", path);
+        success = _lineAtlas_build(
+            lineAtlas, path, imageWidth, pinTable,
+            thicknessClasses, thicknessClassAmount
+        );
+    }
+    free(thicknessClasses);
+
+    if (!success) {
+        free(lineAtlas);
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    DEBUG_EXIT_FUNC();
+    return lineAtlas;
+}
+
+LineAtlas * lineAtlas_replicate(const LineAtlas *self, int node) {
+    DEBUG_ENTER_FUNC();
+    LineAtlas *lineAtlas = (LineAtlas*)calloc(1, sizeof(LineAtlas));
+    if (!lineAtlas) {
+        PRINT_ERROR("error while allocating lineAtlas");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    lineAtlas->indexer = self->indexer;
+
+    void *mapping = mmap(
+        NULL, self->mappingSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (mapping == MAP_FAILED) {
+        PRINT_ERROR("error while mapping line atlas replica");
+        free(lineAtlas);
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    // the pages are not touched yet, so they are allocated on the node
+    // right away when copying; the caller reports a failed placement
+    if (!numaMemory_bind(mapping, self->mappingSize, node)) {
+        munmap(mapping, self->mappingSize);
+        free(lineAtlas);
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    memcpy(mapping, self->mapping, self->mappingSize);
+    if (mprotect(mapping, self->mappingSize, PROT_READ) == -1) {
+        PRINT_ERROR("error while protecting line atlas replica, keeping it writable");
+    }
+
+    _lineAtlas_layout(lineAtlas, mapping, self->mappingSize);
+    DEBUG_EXIT_FUNC();
+    return lineAtlas;
+}
+
+void lineAtlas_delete(LineAtlas *self) {
+    DEBUG_ENTER_FUNC();
+    if (self && self->mapping) {
+        munmap(self->mapping, self->mappingSize);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+uint64_t lineAtlas_thicknessClass(
+    const LineAtlas *self,
+    double thicknessInPixels
+) {
+    DEBUG_ENTER_FUNC();
+    uint64_t result = 0;
+    for (uint64_t i = 0; i < self->header->thicknessClassAmount; ++i) {
+        if (self->thicknessesInPixels[i] == thicknessInPixels) {
+            result = i;
+            break;
+        }
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+uint64_t lineAtlas_line(
+    const LineAtlas *self,
+    uint64_t thicknessClass,
+    uint64_t startIndex,
+    uint64_t endIndex,
+    const uint32_t **pixelIndices,
+    const uint8_t **coverages
+) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t lineIndex = (
+        thicknessClass * indexer_pairAmount(&(self->indexer))
+        + indexer_pairIndex(&(self->indexer), startIndex, endIndex)
+    );
+    const uint64_t begin = self->offsets[lineIndex];
+    const uint64_t end = self->offsets[lineIndex + 1];
+    *pixelIndices = self->pixelIndices + begin;
+    *coverages = self->coverages + begin;
+    DEBUG_EXIT_FUNC();
+    return end - begin;
+}
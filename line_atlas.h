@@ -0,0 +1,72 @@
+#ifndef __LINE_ATLAS_H__
+#define __LINE_ATLAS_H__
+
+#include "shared_data.h"
+#include "pin_table.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef LINE_ATLAS_DIRECTORY
+#define LINE_ATLAS_DIRECTORY "line_atlas_cache"
+#endif // LINE_ATLAS_DIRECTORY
+
+#ifndef LINE_ATLAS_MAX_SIZE
+#define LINE_ATLAS_MAX_SIZE (((size_t)1) << 32)
+#endif // LINE_ATLAS_MAX_SIZE
+
+// File layout, every section starting 8 byte aligned:
+//   LineAtlasHeader
+//   double   thicknessesInPixels[thicknessClassAmount]
+//   uint64_t offsets[thicknessClassAmount * pairAmount + 1]
+//   uint32_t pixelIndices[pixelAmount]
+//   uint8_t  coverages[pixelAmount]
+// The pixels of pair p in thickness class t are the half-open range
+// offsets[t * pairAmount + p] .. offsets[t * pairAmount + p + 1].
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t imageWidth;
+    uint64_t pointAmount;
+    uint64_t thicknessClassAmount;
+    uint64_t pixelAmount;
+} LineAtlasHeader;
+
+typedef struct {
+    void *mapping;
+    size_t mappingSize;
+    const LineAtlasHeader *header;
+    const double *thicknessesInPixels;
+    const uint64_t *offsets;
+    const uint32_t *pixelIndices;
+    const uint8_t *coverages;
+    Indexer indexer;
+} LineAtlas;
+
+LineAtlas * lineAtlas_new(
+    uint64_t imageWidth,
+    const Indexer *indexer,
+    const PinTable *pinTable,
+    const double *thicknessesInPixels,
+    uint64_t thicknessAmount
+);
+void lineAtlas_delete(LineAtlas *self);
+
+// A private copy of the atlas in anonymous memory on the given node, so
+// workers there do not read it from another node's page cache.
+LineAtlas * lineAtlas_replicate(const LineAtlas *self, int node);
+
+uint64_t lineAtlas_thicknessClass(
+    const LineAtlas *self,
+    double thicknessInPixels
+);
+uint64_t lineAtlas_line(
+    const LineAtlas *self,
+    uint64_t thicknessClass,
+    uint64_t startIndex,
+    uint64_t endIndex,
+    const uint32_t **pixelIndices,
+    const uint8_t **coverages
+);
+
+#endif // __LINE_ATLAS_H__
@@ -0,0 +1,311 @@
+#include "line_kernels.h"
+
+#include "debug.h"
+
+// The kernels are written once as plain C and compiled for every
+// instruction set through target attributes, so the binary itself only
+// needs the baseline architecture. Pixels are gathered into small blocks
+// first, which lets the compiler vectorize the mixing and error math.
+
+#define ALWAYS_INLINE __attribute__((always_inline)) inline
+
+static ALWAYS_INLINE int64_t _lineKernels_scoreLine(
+    const LineScoreInput *input,
+    const uint32_t *pixelIndices,
+    const uint8_t *coverages,
+    uint64_t pixelAmount,
+    PixelDelta *pixelDelta
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(
+        pixelDelta->changeAmount + pixelAmount <= pixelDelta->capacity,
+        "pixelDelta capacity exceeded."
+    );
+    const uint32_t colorC = input->color.c;
+    const uint32_t colorM = input->color.m;
+    const uint32_t colorY = input->color.y;
+    int64_t errorDelta = 0;
+    for (uint64_t begin = 0; begin < pixelAmount; begin += LINE_KERNELS_BLOCK_SIZE) {
+        const uint64_t blockSize = (
+            pixelAmount - begin < LINE_KERNELS_BLOCK_SIZE
+            ? pixelAmount - begin
+            : LINE_KERNELS_BLOCK_SIZE
+        );
+        uint8_t oldC[LINE_KERNELS_BLOCK_SIZE];
+        uint8_t oldM[LINE_KERNELS_BLOCK_SIZE];
+        uint8_t oldY[LINE_KERNELS_BLOCK_SIZE];
+        uint8_t targetC[LINE_KERNELS_BLOCK_SIZE];
+        uint8_t targetM[LINE_KERNELS_BLOCK_SIZE];
+        uint8_t targetY[LINE_KERNELS_BLOCK_SIZE];
+        uint32_t mixWeights[LINE_KERNELS_BLOCK_SIZE];
+        uint32_t pixelWeights[LINE_KERNELS_BLOCK_SIZE];
+        uint64_t oldErrors[LINE_KERNELS_BLOCK_SIZE];
+        for (uint64_t i = 0; i < blockSize; ++i) {
+            const uint32_t imageIndex = pixelIndices[begin + i];
+            oldC[i] = input->image->c[imageIndex];
+            oldM[i] = input->image->m[imageIndex];
+            oldY[i] = input->image->y[imageIndex];
+            targetC[i] = input->target->c[imageIndex];
+            targetM[i] = input->target->m[imageIndex];
+            targetY[i] = input->target->y[imageIndex];
+            mixWeights[i] = input->mixWeights[coverages[begin + i]];
+            pixelWeights[i] = input->pixelWeights[imageIndex];
+            oldErrors[i] = input->errorImage[imageIndex];
+        }
+
+        const uint64_t offset = pixelDelta->changeAmount + begin;
+        uint8_t *newC = pixelDelta->colors->c + offset;
+        uint8_t *newM = pixelDelta->colors->m + offset;
+        uint8_t *newY = pixelDelta->colors->y + offset;
+        uint64_t *newErrors = pixelDelta->errors + offset;
+        uint64_t *imageIndices = pixelDelta->imageIndices + offset;
+        for (uint64_t i = 0; i < blockSize; ++i) {
+            // same rounding as color_mixFixed and
+            // color_weightedSquaredErrorFixed
+            const uint32_t weight = mixWeights[i];
+            const uint32_t inverseWeight = COLOR_MIX_WEIGHT_ONE - weight;
+            const uint8_t c = (uint8_t)((oldC[i] * inverseWeight + colorC * weight) >> 16);
+            const uint8_t m = (uint8_t)((oldM[i] * inverseWeight + colorM * weight) >> 16);
+            const uint8_t y = (uint8_t)((oldY[i] * inverseWeight + colorY * weight) >> 16);
+            const uint32_t sqrtError = (
+                (uint32_t)(uint8_t)(targetC[i] - c)
+                + (uint32_t)(uint8_t)(targetM[i] - m)
+                + (uint32_t)(uint8_t)(targetY[i] - y)
+            );
+            const uint64_t error = (
+                (uint64_t)(sqrtError * sqrtError) * pixelWeights[i]
+            );
+            newC[i] = c;
+            newM[i] = m;
+            newY[i] = y;
+            newErrors[i] = error;
+            imageIndices[i] = pixelIndices[begin + i];
+            errorDelta += (int64_t)(error - oldErrors[i]);
+        }
+    }
+    pixelDelta->changeAmount += pixelAmount;
+    DEBUG_EXIT_FUNC();
+    return errorDelta;
+}
+
+static ALWAYS_INLINE int64_t _lineKernels_scorePixel(
+    const LineScoreInput *input,
+    uint64_t imageIndex,
+    uint32_t mixWeight,
+    uint64_t changeIndex,
+    PixelDelta *pixelDelta
+) {
+    DEBUG_ENTER_FUNC();
+    const uint32_t inverseWeight = COLOR_MIX_WEIGHT_ONE - mixWeight;
+    const uint8_t c = (uint8_t)(
+        (input->image->c[imageIndex] * inverseWeight + input->color.c * mixWeight) >> 16
+    );
+    const uint8_t m = (uint8_t)(
+        (input->image->m[imageIndex] * inverseWeight + input->color.m * mixWeight) >> 16
+    );
+    const uint8_t y = (uint8_t)(
+        (input->image->y[imageIndex] * inverseWeight + input->color.y * mixWeight) >> 16
+    );
+    const uint32_t sqrtError = (
+        (uint32_t)(uint8_t)(input->target->c[imageIndex] - c)
+        + (uint32_t)(uint8_t)(input->target->m[imageIndex] - m)
+        + (uint32_t)(uint8_t)(input->target->y[imageIndex] - y)
+    );
+    const uint64_t error = (
+        (uint64_t)(sqrtError * sqrtError) * input->pixelWeights[imageIndex]
+    );
+    pixelDelta->colors->c[changeIndex] = c;
+    pixelDelta->colors->m[changeIndex] = m;
+    pixelDelta->colors->y[changeIndex] = y;
+    pixelDelta->errors[changeIndex] = error;
+    pixelDelta->imageIndices[changeIndex] = imageIndex;
+    const int64_t result = (int64_t)(error - input->errorImage[imageIndex]);
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+// Scores one span of the given length. Called with a constant length, the
+// loop over the fully covered pixels is unrolled completely.
+static ALWAYS_INLINE int64_t _lineKernels_scoreSpan(
+    const LineScoreInput *input,
+    const LineSpan *span,
+    uint64_t length,
+    uint32_t interiorMixWeight,
+    uint64_t changeIndex,
+    PixelDelta *pixelDelta
+) {
+    DEBUG_ENTER_FUNC();
+    int64_t errorDelta = _lineKernels_scorePixel(
+        input, span->pixelIndex,
+        input->mixWeights[span->startCoverage], changeIndex, pixelDelta
+    );
+    for (uint64_t i = 1; i + 1 < length; ++i) {
+        errorDelta += _lineKernels_scorePixel(
+            input, span->pixelIndex + i * span->stride,
+            interiorMixWeight, changeIndex + i, pixelDelta
+        );
+    }
+    if (length > 1) {
+        errorDelta += _lineKernels_scorePixel(
+            input, span->pixelIndex + (length - 1) * span->stride,
+            input->mixWeights[span->endCoverage], changeIndex + length - 1,
+            pixelDelta
+        );
+    }
+    DEBUG_EXIT_FUNC();
+    return errorDelta;
+}
+
+static ALWAYS_INLINE int64_t _lineKernels_scoreSpans(
+    const LineScoreInput *input,
+    const LineSpan *spans,
+    uint64_t spanAmount,
+    PixelDelta *pixelDelta
+) {
+    DEBUG_ENTER_FUNC();
+    const uint32_t interiorMixWeight = input->mixWeights[UINT8_MAX];
+    uint64_t changeIndex = pixelDelta->changeAmount;
+    int64_t errorDelta = 0;
+    for (uint64_t i = 0; i < spanAmount; ++i) {
+        const LineSpan *span = &(spans[i]);
+        DEBUG_ASSERT(
+            changeIndex + span->length <= pixelDelta->capacity,
+            "pixelDelta capacity exceeded."
+        );
+        // unclipped spans of lines thinner than 4 pixels have one of the
+        // specialized lengths, the remaining ones take the generic loop
+        switch (span->length) {
+            case 2:
+                errorDelta += _lineKernels_scoreSpan(
+                    input, span, 2, interiorMixWeight, changeIndex, pixelDelta
+                );
+                break;
+            case 3:
+                errorDelta += _lineKernels_scoreSpan(
+                    input, span, 3, interiorMixWeight, changeIndex, pixelDelta
+                );
+                break;
+            case 4:
+                errorDelta += _lineKernels_scoreSpan(
+                    input, span, 4, interiorMixWeight, changeIndex, pixelDelta
+                );
+                break;
+            default:
+                errorDelta += _lineKernels_scoreSpan(
+                    input, span, span->length, interiorMixWeight,
+                    changeIndex, pixelDelta
+                );
+                break;
+        }
+        changeIndex += span->length;
+    }
+    pixelDelta->changeAmount = changeIndex;
+    DEBUG_EXIT_FUNC();
+    return errorDelta;
+}
+
+static ALWAYS_INLINE void _lineKernels_commitLine(
+    const PixelDelta *pixelDelta,
+    PlanarImage *image,
+    uint64_t *errorImage
+) {
+    DEBUG_ENTER_FUNC();
+    const PlanarImage *colors = pixelDelta->colors;
+    for (uint64_t i = 0; i < pixelDelta->changeAmount; ++i) {
+        const uint64_t imageIndex = pixelDelta->imageIndices[i];
+        image->c[imageIndex] = colors->c[i];
+        image->m[imageIndex] = colors->m[i];
+        image->y[imageIndex] = colors->y[i];
+        errorImage[imageIndex] = pixelDelta->errors[i];
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+#define LINE_KERNELS_DEFINE(suffix, targetAttribute) \
+    targetAttribute int64_t _lineKernels_scoreLine_##suffix( \
+        const LineScoreInput *input, \
+        const uint32_t *pixelIndices, \
+        const uint8_t *coverages, \
+        uint64_t pixelAmount, \
+        PixelDelta *pixelDelta \
+    ) { \
+        return _lineKernels_scoreLine( \
+            input, pixelIndices, coverages, pixelAmount, pixelDelta \
+        ); \
+    } \
+    targetAttribute int64_t _lineKernels_scoreSpans_##suffix( \
+        const LineScoreInput *input, \
+        const LineSpan *spans, \
+        uint64_t spanAmount, \
+        PixelDelta *pixelDelta \
+    ) { \
+        return _lineKernels_scoreSpans(input, spans, spanAmount, pixelDelta); \
+    } \
+    targetAttribute void _lineKernels_commitLine_##suffix( \
+        const PixelDelta *pixelDelta, \
+        PlanarImage *image, \
+        uint64_t *errorImage \
+    ) { \
+        _lineKernels_commitLine(pixelDelta, image, errorImage); \
+    }
+
+LINE_KERNELS_DEFINE(generic, )
+
+static const LineKernels _lineKernels_generic = {
+    .name = "generic",
+    .scoreLine = _lineKernels_scoreLine_generic,
+    .scoreSpans = _lineKernels_scoreSpans_generic,
+    .commitLine = _lineKernels_commitLine_generic
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+LINE_KERNELS_DEFINE(sse42, __attribute__((target("sse4.2"))))
+LINE_KERNELS_DEFINE(avx2, __attribute__((target("avx2,bmi2"))))
+LINE_KERNELS_DEFINE(avx512, __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq"))))
+
+static const LineKernels _lineKernels_sse42 = {
+    .name = "sse4.2",
+    .scoreLine = _lineKernels_scoreLine_sse42,
+    .scoreSpans = _lineKernels_scoreSpans_sse42,
+    .commitLine = _lineKernels_commitLine_sse42
+};
+
+static const LineKernels _lineKernels_avx2 = {
+    .name = "avx2",
+    .scoreLine = _lineKernels_scoreLine_avx2,
+    .scoreSpans = _lineKernels_scoreSpans_avx2,
+    .commitLine = _lineKernels_commitLine_avx2
+};
+
+static const LineKernels _lineKernels_avx512 = {
+    .name = "avx512",
+    .scoreLine = _lineKernels_scoreLine_avx512,
+    .scoreSpans = _lineKernels_scoreSpans_avx512,
+    .commitLine = _lineKernels_commitLine_avx512
+};
+
+#endif // __x86_64__ || __i386__
+
+const LineKernels * lineKernels_select(void) {
+    DEBUG_ENTER_FUNC();
+    const LineKernels *result = &_lineKernels_generic;
+#if defined(__x86_64__) || defined(__i386__)
+    // __builtin_cpu_supports reads the CPUID bits once at startup
+    __builtin_cpu_init();
+    if (
+        __builtin_cpu_supports("avx512f")
+        && __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("avx512vl")
+        && __builtin_cpu_supports("avx512dq")
+    ) {
+        result = &_lineKernels_avx512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+        result = &_lineKernels_avx2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        result = &_lineKernels_sse42;
+    }
+#endif // __x86_64__ || __i386__
+    DEBUG_EXIT_FUNC();
+    return result;
+}
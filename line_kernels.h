@@ -0,0 +1,61 @@
+#ifndef __LINE_KERNELS_H__
+#define __LINE_KERNELS_H__
+
+#include "color.h"
+#include "planar_image.h"
+#include "pixel_delta.h"
+#include "line_renderer.h"
+
+#include <stdint.h>
+
+#ifndef LINE_KERNELS_BLOCK_SIZE
+#define LINE_KERNELS_BLOCK_SIZE (64)
+#endif // LINE_KERNELS_BLOCK_SIZE
+
+// Everything needed to score lines of one thread against the current image.
+// mixWeights holds the UINT8_MAX + 1 fixed point mix weights of the thread,
+// indexed by coverage.
+typedef struct {
+    const PlanarImage *target;
+    const PlanarImage *image;
+    const uint64_t *errorImage;
+    const uint16_t *pixelWeights;
+    const uint32_t *mixWeights;
+    Color color;
+} LineScoreInput;
+
+// Mixes the thread into every given pixel, appends the new colors and
+// errors to pixelDelta and returns the change of the total error.
+typedef int64_t (*ScoreLineKernel)(
+    const LineScoreInput *input,
+    const uint32_t *pixelIndices,
+    const uint8_t *coverages,
+    uint64_t pixelAmount,
+    PixelDelta *pixelDelta
+);
+// Same as ScoreLineKernel for the pixels of rasterized spans, without
+// expanding them into index and coverage arrays first.
+typedef int64_t (*ScoreSpansKernel)(
+    const LineScoreInput *input,
+    const LineSpan *spans,
+    uint64_t spanAmount,
+    PixelDelta *pixelDelta
+);
+// Writes the colors and errors of pixelDelta into the image.
+typedef void (*CommitLineKernel)(
+    const PixelDelta *pixelDelta,
+    PlanarImage *image,
+    uint64_t *errorImage
+);
+
+typedef struct {
+    const char *name;
+    ScoreLineKernel scoreLine;
+    ScoreSpansKernel scoreSpans;
+    CommitLineKernel commitLine;
+} LineKernels;
+
+// Returns the kernels for the widest instruction set the CPU supports.
+const LineKernels * lineKernels_select(void);
+
+#endif // __LINE_KERNELS_H__
@@ -7,7 +7,15 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
-LineRenderer * lineRenderer_new(DrawPixelFunction drawPixelFunction) {
+// The fixed point rasterizer steps the minor axis coordinate with
+// LINE_RENDERER_FRACTION_BITS fractional bits. Coverages are computed from
+// its top 16 fractional bits.
+#define LINE_RENDERER_FRACTION_BITS (32)
+#define LINE_RENDERER_FIXED_ONE ((int64_t)1 << LINE_RENDERER_FRACTION_BITS)
+#define LINE_RENDERER_FRACTION_MASK (LINE_RENDERER_FIXED_ONE - 1)
+#define COVERAGE_FRACTION_BITS (16)
+
+LineRenderer * lineRenderer_new(void) {
     DEBUG_ENTER_FUNC();
     LineRenderer *lineRenderer = (LineRenderer*)malloc(sizeof(LineRenderer));
     if (!lineRenderer) {
@@ -16,8 +24,11 @@ LineRenderer * lineRenderer_new(DrawPixelFunction drawPixelFunction) {
         return NULL;
     }
 
-    lineRenderer->drawPixelFunction = drawPixelFunction;
-    lineRenderer->argument = NULL;
+    lineRenderer->spans = NULL;
+    lineRenderer->spanAmount = 0;
+    lineRenderer->imageWidth = 0;
+    lineRenderer->clipFirst = NULL;
+    lineRenderer->clipLast = NULL;
 
     DEBUG_EXIT_FUNC();
     return lineRenderer;
@@ -25,17 +36,172 @@ LineRenderer * lineRenderer_new(DrawPixelFunction drawPixelFunction) {
 
 void lineRenderer_delete(LineRenderer *self) {
     DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->clipLast);
+        free(self->clipFirst);
+    }
     free(self);
     DEBUG_EXIT_FUNC();
 }
 
-void lineRenderer_setArgument(LineRenderer *self, void *argument) {
+bool lineRenderer_setClipRegion(
+    LineRenderer *self,
+    uint64_t imageWidth,
+    bool clipToDisc
+) {
+    DEBUG_ENTER_FUNC();
+    int64_t *clipFirst = (int64_t*)realloc(
+        self->clipFirst, imageWidth * sizeof(int64_t)
+    );
+    if (!clipFirst) {
+        PRINT_ERROR("error while allocating lineRenderer->clipFirst");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    self->clipFirst = clipFirst;
+
+    int64_t *clipLast = (int64_t*)realloc(
+        self->clipLast, imageWidth * sizeof(int64_t)
+    );
+    if (!clipLast) {
+        PRINT_ERROR("error while allocating lineRenderer->clipLast");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    self->clipLast = clipLast;
+
+    self->imageWidth = imageWidth;
+    const int64_t imageRadius = (int64_t)imageWidth / 2;
+    for (int64_t i = 0; i < (int64_t)imageWidth; ++i) {
+        if (!clipToDisc) {
+            clipFirst[i] = 0;
+            clipLast[i] = (int64_t)imageWidth - 1;
+            continue;
+        }
+        // pixel (i, j) is inside if (i - r)^2 + (j - r)^2 <= r^2
+        const int64_t d = i - imageRadius;
+        const int64_t squaredHalfChord = imageRadius * imageRadius - d * d;
+        if (squaredHalfChord < 0) {
+            clipFirst[i] = 0;
+            clipLast[i] = -1;
+            continue;
+        }
+        int64_t halfChord = (int64_t)sqrt((double)squaredHalfChord);
+        while (halfChord * halfChord > squaredHalfChord) {
+            --halfChord;
+        }
+        while ((halfChord + 1) * (halfChord + 1) <= squaredHalfChord) {
+            ++halfChord;
+        }
+        clipFirst[i] = imageRadius - halfChord;
+        clipLast[i] = imageRadius + halfChord;
+        if (clipLast[i] > (int64_t)imageWidth - 1) {
+            clipLast[i] = (int64_t)imageWidth - 1;
+        }
+    }
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+uint64_t _lineRenderer_pixelWidth(double width) {
     DEBUG_ENTER_FUNC();
-    self->argument = argument;
+    // offset of the far edge pixel; interior pixels lie strictly between
+    // both edges so that no pixel of a column is emitted twice
+    uint64_t result = (width < 1.0) ? 1 : (uint64_t)width;
     DEBUG_EXIT_FUNC();
+    return result;
 }
 
-double _lineRenderer_drawEndPoint(LineRenderer *self, double x, double y, double width, double gradient, bool isSteep, uint64_t *xPixels) {
+uint8_t _lineRenderer_coverage(double intensity) {
+    DEBUG_ENTER_FUNC();
+    uint8_t result = (uint8_t)lround(intensity * (double)UINT8_MAX);
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+// Clips the span of uWidth + 1 pixels starting at minor of column or row
+// major to the clip region and writes it to span. Returns false if
+// nothing of it is left. The renderer's fields are passed in explicitly, so
+// loops over many spans can keep them in registers.
+bool _lineRenderer_clipSpan(
+    const int64_t *clipFirstTable,
+    const int64_t *clipLastTable,
+    uint64_t imageWidth,
+    bool isSteep,
+    uint64_t major,
+    uint64_t minor,
+    uint64_t uWidth,
+    uint8_t firstCoverage,
+    uint8_t lastCoverage,
+    LineSpan *span
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(major < imageWidth, "major has to be inside the image.");
+    // rows above or columns left of the image wrapped around, so they are
+    // compared as signed values
+    const int64_t majorIndex = (int64_t)major;
+    const int64_t first = (int64_t)minor;
+    const int64_t last = first + (int64_t)uWidth;
+    const int64_t clipFirst = clipFirstTable[majorIndex];
+    const int64_t clipLast = clipLastTable[majorIndex];
+    const int64_t clippedFirst = first < clipFirst ? clipFirst : first;
+    const int64_t clippedLast = last > clipLast ? clipLast : last;
+    if (clippedFirst > clippedLast) {
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    // clipped edge pixels are replaced by interior ones
+    const uint8_t startCoverage = (
+        clippedFirst == first
+        ? firstCoverage
+        : (clippedFirst == last ? lastCoverage : UINT8_MAX)
+    );
+    const uint8_t endCoverage = clippedLast == last ? lastCoverage : UINT8_MAX;
+    *span = (LineSpan){
+        .pixelIndex = (
+            isSteep
+            ? (uint64_t)(majorIndex * (int64_t)imageWidth + clippedFirst)
+            : (uint64_t)(clippedFirst * (int64_t)imageWidth + majorIndex)
+        ),
+        .stride = isSteep ? 1 : (uint32_t)imageWidth,
+        .length = (uint16_t)(clippedLast - clippedFirst + 1),
+        .startCoverage = startCoverage,
+        .endCoverage = endCoverage
+    };
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+// Appends the span of the uWidth + 1 pixels of one column, or one row if
+// the line is steep, starting at minor: the first and the last one with
+// the given intensities, all pixels in between fully covered.
+void _lineRenderer_drawSpan(
+    LineRenderer *self,
+    bool isSteep,
+    uint64_t major,
+    uint64_t minor,
+    uint64_t uWidth,
+    double startIntensity,
+    double endIntensity
+) {
+    DEBUG_ENTER_FUNC();
+    // end points may lie one column right of the image
+    if (major >= self->imageWidth) {
+        DEBUG_EXIT_FUNC();
+        return;
+    }
+    self->spanAmount += _lineRenderer_clipSpan(
+        self->clipFirst, self->clipLast, self->imageWidth,
+        isSteep, major, minor, uWidth,
+        _lineRenderer_coverage(startIntensity),
+        _lineRenderer_coverage(endIntensity),
+        &(self->spans[self->spanAmount])
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+double _lineRenderer_drawEndPoint(LineRenderer *self, double x, double y, double width, double gradient, bool isSteep, bool isLast, uint64_t *xPixels) {
     DEBUG_ENTER_FUNC();
     DEBUG_ASSERT(width > 0.0, "width has to be greater than 0.");
     DEBUG_ASSERT(x >= 0.0, "x has to be greater than or equal to 0.");
@@ -44,107 +210,202 @@ double _lineRenderer_drawEndPoint(LineRenderer *self, double x, double y, double
     const double yPoint = (
         y - (width - 1.0) * 0.5 + gradient * (xPoint - x)
     );
-    const double xGap = 1.0 - (x + 0.5 - xPoint);
+    // share of the end point column covered by the line, which lies right
+    // of x for the first and left of it for the last end point; both are
+    // 0.5 for integer end points
+    const double xGap = isLast ? x + 0.5 - xPoint : 1.0 - (x + 0.5 - xPoint);
     *xPixels = (uint64_t)xPoint;
-    const double yPixels = (uint64_t)yPoint;
+    // rows above the image are negative, they wrap to huge unsigned
+    // coordinates and are clipped off the span
+    const uint64_t yPixels = (uint64_t)(int64_t)floor(yPoint);
     const double fPart = yPoint - floor(yPoint);
     const double rfPart = 1.0 - fPart;
-    const uint64_t uWidth = (uint64_t)width;
+    const uint64_t uWidth = _lineRenderer_pixelWidth(width);
 
-    if (isSteep) {
-        self->drawPixelFunction(yPixels, *xPixels, rfPart * xGap, self->argument);
-        for (uint64_t i = 1; i < width; ++i) {
-            self->drawPixelFunction(yPixels + i, *xPixels, 1.0, self->argument);
-        }
-        self->drawPixelFunction(yPixels + uWidth, *xPixels, fPart * xGap, self->argument);
-    } else {
-        self->drawPixelFunction(*xPixels, yPixels, rfPart * xGap, self->argument);
-        for (uint64_t i = 1; i < width; ++i) {
-            self->drawPixelFunction(*xPixels, yPixels + i, 1.0, self->argument);
-        }
-        self->drawPixelFunction(*xPixels, yPixels + uWidth, fPart * xGap, self->argument);
-    }
+    _lineRenderer_drawSpan(
+        self, isSteep, *xPixels, yPixels, uWidth, rfPart * xGap, fPart * xGap
+    );
 
     DEBUG_EXIT_FUNC();
     return yPoint;
 }
 
-void lineRenderer_draw(
+uint64_t lineRenderer_drawSpansFixed(
     LineRenderer *self,
-    uint64_t x0,
-    uint64_t y0,
-    uint64_t x1,
-    uint64_t y1,
-    double width
+    double x0,
+    double y0,
+    double x1,
+    double y1,
+    double width,
+    LineSpan *spans
 ) {
     DEBUG_ENTER_FUNC();
-    // https://github.com/jambolo/thick-xiaolin-wu/blob/master/cs/thick-xiaolin-wu.coffee
-    const bool isSteep = fabs(y1 - y0) > fabs(x1 - x0);
-
-    if (isSteep) {
-        double temp = x0;
-        x0 = y0;
-        y0 = temp;
-        temp = x1;
-        x1 = y1;
-        y1 = temp;
-    }
+    // a fan of one line, so that single lines and fans share every
+    // floating point operation
+    uint64_t spanAmount = 0;
+    lineRenderer_drawSpanFan(
+        self, x0, y0, &x1, &y1, 1, width, spans, 0, &spanAmount
+    );
+    DEBUG_EXIT_FUNC();
+    return spanAmount;
+}
 
-    if (x0 > x1) {
-        double temp = x0;
-        x0 = x1;
-        x1 = temp;
-        temp = y0;
-        y0 = y1;
-        y1 = temp;
+void _lineRenderer_stepFixed(
+    LineRenderer *self,
+    bool isSteep,
+    uint64_t xPixels0,
+    uint64_t xPixels1,
+    double yPoint0,
+    double gradient,
+    uint64_t uWidth
+) {
+    DEBUG_ENTER_FUNC();
+    const int64_t fixedGradient = llround(gradient * (double)LINE_RENDERER_FIXED_ONE);
+    int64_t intery = llround((yPoint0 + gradient) * (double)LINE_RENDERER_FIXED_ONE);
+
+    // columns right of the image are cut off up front, the rows of the
+    // remaining spans are clipped against the clip region table
+    const uint64_t imageWidth = self->imageWidth;
+    const uint64_t xEnd = xPixels1 < imageWidth ? xPixels1 : imageWidth;
+    const int64_t *clipFirst = self->clipFirst;
+    const int64_t *clipLast = self->clipLast;
+    LineSpan *spans = self->spans;
+    uint64_t spanAmount = self->spanAmount;
+    for (uint64_t x = xPixels0 + 1; x < xEnd; ++x) {
+        // the arithmetic shift floors negative rows as well
+        const int64_t y = intery >> LINE_RENDERER_FRACTION_BITS;
+        const uint64_t fPart = (
+            (uint64_t)(intery & LINE_RENDERER_FRACTION_MASK)
+            >> (LINE_RENDERER_FRACTION_BITS - COVERAGE_FRACTION_BITS)
+        );
+        const uint8_t lastCoverage = (uint8_t)(
+            (fPart * UINT8_MAX + (1 << (COVERAGE_FRACTION_BITS - 1)))
+            >> COVERAGE_FRACTION_BITS
+        );
+
+        spanAmount += _lineRenderer_clipSpan(
+            clipFirst, clipLast, imageWidth, isSteep, x, (uint64_t)y, uWidth,
+            UINT8_MAX - lastCoverage, lastCoverage, &(spans[spanAmount])
+        );
+
+        intery += fixedGradient;
     }
+    self->spanAmount = spanAmount;
+    DEBUG_EXIT_FUNC();
+}
+
+void lineRenderer_drawSpanFan(
+    LineRenderer *self,
+    double x0,
+    double y0,
+    const double *x1,
+    const double *y1,
+    uint64_t lineAmount,
+    double width,
+    LineSpan *spans,
+    uint64_t spanStride,
+    uint64_t *spanAmounts
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(self->clipFirst, "the clip region has to be set.");
+    DEBUG_ASSERT(lineAmount <= LINE_RENDERER_FAN_SIZE, "fan too large.");
+    // https://github.com/jambolo/thick-xiaolin-wu/blob/master/cs/thick-xiaolin-wu.coffee
 
-    const double dx = (double)x1 - (double)x0;
-    const double dy = (double)y1 - (double)y0;
-    const double gradient = (dx > 0.0) ? dy / dx : 1.0;
+    // the set up is written without branches over arrays of the fan, so the
+    // compiler can run it for several lines per instruction
+    bool isSteep[LINE_RENDERER_FAN_SIZE];
+    double majors0[LINE_RENDERER_FAN_SIZE];
+    double minors0[LINE_RENDERER_FAN_SIZE];
+    double majors1[LINE_RENDERER_FAN_SIZE];
+    double minors1[LINE_RENDERER_FAN_SIZE];
+    double gradients[LINE_RENDERER_FAN_SIZE];
+    double widths[LINE_RENDERER_FAN_SIZE];
+    for (uint64_t i = 0; i < lineAmount; ++i) {
+        const bool steep = fabs(y1[i] - y0) > fabs(x1[i] - x0);
+        const double startMajor = steep ? y0 : x0;
+        const double startMinor = steep ? x0 : y0;
+        const double endMajor = steep ? y1[i] : x1[i];
+        const double endMinor = steep ? x1[i] : y1[i];
+        // the end points are ordered along the major axis
+        const bool isReversed = startMajor > endMajor;
+        majors0[i] = isReversed ? endMajor : startMajor;
+        minors0[i] = isReversed ? endMinor : startMinor;
+        majors1[i] = isReversed ? startMajor : endMajor;
+        minors1[i] = isReversed ? startMinor : endMinor;
+        const double dx = majors1[i] - majors0[i];
+        const double dy = minors1[i] - minors0[i];
+        gradients[i] = (dx > 0.0) ? dy / dx : 1.0;
+        widths[i] = width * sqrt(1.0 + gradients[i] * gradients[i]);
+        isSteep[i] = steep;
+    }
 
-    width *= sqrt(1.0 + gradient * gradient);
+    // only the end points are set up in floating point, the columns in
+    // between are stepped with integer adds
+    for (uint64_t i = 0; i < lineAmount; ++i) {
+        self->spans = spans + i * spanStride;
+        self->spanAmount = 0;
+        uint64_t xPixels0 = 0;
+        uint64_t xPixels1 = 0;
+        _lineRenderer_drawEndPoint(
+            self, majors1[i], minors1[i], widths[i], gradients[i],
+            isSteep[i], true, &xPixels1
+        );
+        const double yPoint0 = _lineRenderer_drawEndPoint(
+            self, majors0[i], minors0[i], widths[i], gradients[i],
+            isSteep[i], false, &xPixels0
+        );
+        _lineRenderer_stepFixed(
+            self, isSteep[i], xPixels0, xPixels1, yPoint0, gradients[i],
+            _lineRenderer_pixelWidth(widths[i])
+        );
+        spanAmounts[i] = self->spanAmount;
+    }
 
-    uint64_t xPixels0 = 0;
-    uint64_t xPixels1 = 0;
-    _lineRenderer_drawEndPoint(
-        self, x1, y1, width, gradient, isSteep, &xPixels1
-    );
-    const double yPoint0 = _lineRenderer_drawEndPoint(
-        self, x0, y0, width, gradient, isSteep, &xPixels0
-    );
-    double intery = yPoint0 + gradient;
-
-    const uint64_t uWidth = (uint64_t)width;
-    if (isSteep) {
-        for (uint64_t x = xPixels0 + 1; x < xPixels1; ++x) {
-            const double fPart = intery - floor(intery);
-            const double rfPart = 1.0 - fPart;
-            const uint64_t y = (uint64_t)intery;
-
-            self->drawPixelFunction(y, x, rfPart, self->argument);
-            for (uint64_t i = 1; i < width; ++i) {
-                self->drawPixelFunction(y + i, x, 1.0, self->argument);
-            }
-            self->drawPixelFunction(y + uWidth, x, fPart, self->argument);
+    self->spans = NULL;
+    DEBUG_EXIT_FUNC();
+}
 
-            intery += gradient;
-        }
-    } else {
-        for (uint64_t x = xPixels0 + 1; x < xPixels1; ++x) {
-            const double fPart = intery - floor(intery);
-            const double rfPart = 1.0 - fPart;
-            const uint64_t y = (uint64_t)intery;
-
-            self->drawPixelFunction(x, y, rfPart, self->argument);
-            for (uint64_t i = 1; i < width; ++i) {
-                self->drawPixelFunction(x, y + i, 1.0, self->argument);
+uint64_t lineRenderer_expandSpans(
+    const LineSpan *spans,
+    uint64_t spanAmount,
+    uint32_t *pixelIndices,
+    uint8_t *coverages
+) {
+    DEBUG_ENTER_FUNC();
+    uint64_t pixelAmount = 0;
+    for (uint64_t i = 0; i < spanAmount; ++i) {
+        const LineSpan *span = &(spans[i]);
+        if (pixelIndices) {
+            uint32_t *spanPixelIndices = pixelIndices + pixelAmount;
+            uint8_t *spanCoverages = coverages + pixelAmount;
+            for (uint64_t j = 0; j < span->length; ++j) {
+                spanPixelIndices[j] = (uint32_t)(span->pixelIndex + j * span->stride);
+                spanCoverages[j] = UINT8_MAX;
             }
-            self->drawPixelFunction(x, y + uWidth, fPart, self->argument);
-
-            intery += gradient;
+            spanCoverages[span->length - 1] = span->endCoverage;
+            spanCoverages[0] = span->startCoverage;
         }
+        pixelAmount += span->length;
     }
+    DEBUG_EXIT_FUNC();
+    return pixelAmount;
+}
+
+uint64_t lineRenderer_maxPixelAmount(uint64_t imageWidth, double width) {
+    DEBUG_ENTER_FUNC();
+    // every column gets two edge pixels plus the interior of the widened
+    // line, whose width grows by at most sqrt(2) for diagonal lines
+    const uint64_t pixelsPerColumn = (uint64_t)ceil(width * M_SQRT2) + 2;
+    const uint64_t columnAmount = imageWidth + 2;
+    uint64_t result = pixelsPerColumn * columnAmount;
+    DEBUG_EXIT_FUNC();
+    return result;
+}
 
+uint64_t lineRenderer_maxSpanAmount(uint64_t imageWidth) {
+    DEBUG_ENTER_FUNC();
+    // one span per column or row, the end point columns may repeat one
+    const uint64_t result = imageWidth + 2;
     DEBUG_EXIT_FUNC();
-}
\ No newline at end of file
+    return result;
+}
@@ -2,31 +2,90 @@
 #define __LINE_RENDERER_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 
-typedef void(*DrawPixelFunction)(
-    uint64_t x,
-    uint64_t y,
-    double intensity,
-    void *argument
-);
+#ifndef LINE_RENDERER_FAN_SIZE
+#define LINE_RENDERER_FAN_SIZE (8)
+#endif // LINE_RENDERER_FAN_SIZE
+
+// Run of length pixels of one column (flat lines) or one row (steep
+// lines), clipped to the image. Pixel i has the image index
+// pixelIndex + i * stride. The first pixel is covered by startCoverage,
+// the last one by endCoverage and all pixels in between fully. The fields
+// leave no padding, so the layout does not depend on whether a packing
+// pragma of another header is in effect.
+typedef struct {
+    uint64_t pixelIndex;
+    uint32_t stride;
+    uint16_t length;
+    uint8_t startCoverage;
+    uint8_t endCoverage;
+} LineSpan;
 
+// Spans are clipped to the pixels clipFirst[i] .. clipLast[i] of column or
+// row i, which is the whole image square or only the disc inscribed in it.
+// The disc is symmetric, so one table serves columns and rows.
 typedef struct {
-    DrawPixelFunction drawPixelFunction;
-    void *argument;
+    LineSpan *spans;
+    uint64_t spanAmount;
+    uint64_t imageWidth;
+    int64_t *clipFirst;
+    int64_t *clipLast;
 } LineRenderer;
 
-LineRenderer * lineRenderer_new(DrawPixelFunction drawPixelFunction);
+LineRenderer * lineRenderer_new(void);
 void lineRenderer_delete(LineRenderer *self);
 
-void lineRenderer_setArgument(LineRenderer *self, void *argument);
-void lineRenderer_draw(
+// Has to be called before spans are drawn. With clipToDisc only pixels
+// inside the disc of radius imageWidth / 2 around the image center are
+// emitted, which are the pixels the optimizer treats as part of the disc.
+bool lineRenderer_setClipRegion(
+    LineRenderer *self,
+    uint64_t imageWidth,
+    bool clipToDisc
+);
+// Rasterizes a thick anti aliased line (thick Xiaolin Wu) into one span
+// per column or row and returns their amount. Spans are clipped to the
+// clip region. spans needs room for lineRenderer_maxSpanAmount spans. The
+// end points keep their sub pixel position, the columns or rows in
+// between are stepped with integer adds in 32.32 fixed point.
+uint64_t lineRenderer_drawSpansFixed(
     LineRenderer *self,
-    uint64_t x0,
-    uint64_t y0,
-    uint64_t x1,
-    uint64_t y1,
-    double width
+    double x0,
+    double y0,
+    double x1,
+    double y1,
+    double width,
+    LineSpan *spans
 );
+// Rasterizes up to LINE_RENDERER_FAN_SIZE lines from the shared start
+// point x0, y0 to x1[i], y1[i] exactly like lineRenderer_drawSpansFixed.
+// The set up of all lines runs first as one loop over the fan, then the
+// lines are stepped one after another. The spans of line i are written to
+// spans + i * spanStride and their amount to spanAmounts[i].
+void lineRenderer_drawSpanFan(
+    LineRenderer *self,
+    double x0,
+    double y0,
+    const double *x1,
+    const double *y1,
+    uint64_t lineAmount,
+    double width,
+    LineSpan *spans,
+    uint64_t spanStride,
+    uint64_t *spanAmounts
+);
+// Writes the pixels of the spans in order and returns their amount. Only
+// counts them if pixelIndices is NULL.
+uint64_t lineRenderer_expandSpans(
+    const LineSpan *spans,
+    uint64_t spanAmount,
+    uint32_t *pixelIndices,
+    uint8_t *coverages
+);
+
+uint64_t lineRenderer_maxPixelAmount(uint64_t imageWidth, double width);
+uint64_t lineRenderer_maxSpanAmount(uint64_t imageWidth);
 
 
 #endif // __LINE_RENDERER_H__
@@ -3,6 +3,7 @@
 
 #include "shared_data.h"
 #include "optimizer.h"
+#include "line_kernels.h"
 #include "error_handling.h"
 #include "debug.h"
 
@@ -89,6 +90,8 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    printf("line kernels: %s\n", lineKernels_select()->name);
+
     SharedData sharedData;
     if (!sharedData_attach(&sharedData, sharedMemoryKey, sharedMemorySize)) {
         DEBUG_EXIT_FUNC();
@@ -0,0 +1,83 @@
+#include "numa_memory.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+int numaMemory_cpuNode(int cpuIndex) {
+    DEBUG_ENTER_FUNC();
+    // sysfs links every CPU to its node as cpu<i>/node<n>
+    for (int node = 0; node < NUMA_MEMORY_MAX_NODE_AMOUNT; ++node) {
+        char path[PATH_MAX];
+        snprintf(
+            path, sizeof(path), NUMA_MEMORY_CPU_DIRECTORY "/cpu%d/node%d",
+            cpuIndex, node
+        );
+        if (access(path, F_OK) == 0) {
+            DEBUG_EXIT_FUNC();
+            return node;
+        }
+    }
+    DEBUG_EXIT_FUNC();
+    return 0;
+}
+
+bool _numaMemory_setPolicy(
+    void *memory,
+    size_t size,
+    int mode,
+    unsigned long nodeMask,
+    unsigned int flags
+) {
+    DEBUG_ENTER_FUNC();
+    const uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = ((uintptr_t)memory + pageSize - 1) & ~(pageSize - 1);
+    const uintptr_t end = ((uintptr_t)memory + size) & ~(pageSize - 1);
+    if (end <= begin) {
+        DEBUG_EXIT_FUNC();
+        return true;
+    }
+    // the kernel expects one more than the amount of bits in the mask
+    const long error = syscall(
+        SYS_mbind, (void*)begin, (unsigned long)(end - begin), mode,
+        &nodeMask, sizeof(nodeMask) * CHAR_BIT + 1, flags
+    );
+    DEBUG_EXIT_FUNC();
+    return error == 0;
+}
+
+bool numaMemory_bind(void *memory, size_t size, int node) {
+    DEBUG_ENTER_FUNC();
+    const bool result = (
+        node >= 0 && node < NUMA_MEMORY_MAX_NODE_AMOUNT
+        && _numaMemory_setPolicy(memory, size, MPOL_BIND, 1UL << node, 0)
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+bool numaMemory_interleave(
+    void *memory,
+    size_t size,
+    const int *nodes,
+    size_t nodeAmount
+) {
+    DEBUG_ENTER_FUNC();
+    unsigned long nodeMask = 0;
+    for (size_t i = 0; i < nodeAmount; ++i) {
+        if (nodes[i] < 0 || nodes[i] >= NUMA_MEMORY_MAX_NODE_AMOUNT) {
+            DEBUG_EXIT_FUNC();
+            return false;
+        }
+        nodeMask |= 1UL << nodes[i];
+    }
+    const bool result = nodeMask != 0 && _numaMemory_setPolicy(
+        memory, size, MPOL_INTERLEAVE, nodeMask, MPOL_MF_MOVE
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
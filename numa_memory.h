@@ -0,0 +1,33 @@
+#ifndef __NUMA_MEMORY_H__
+#define __NUMA_MEMORY_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef NUMA_MEMORY_CPU_DIRECTORY
+#define NUMA_MEMORY_CPU_DIRECTORY "/sys/devices/system/cpu"
+#endif // NUMA_MEMORY_CPU_DIRECTORY
+
+// nodes beyond this amount are treated as node 0, and placing memory on
+// them fails
+#ifndef NUMA_MEMORY_MAX_NODE_AMOUNT
+#define NUMA_MEMORY_MAX_NODE_AMOUNT (64)
+#endif // NUMA_MEMORY_MAX_NODE_AMOUNT
+
+// The memory node of a CPU, 0 if the system has no NUMA information.
+int numaMemory_cpuNode(int cpuIndex);
+
+// Places the whole pages of memory .. memory + size - 1 on one node or
+// interleaves them over the listed nodes. Binding only applies to pages
+// touched afterwards, interleaving also moves pages that were touched
+// already. Partial pages at the ends stay where they are. Both fail
+// without side effects on kernels without NUMA support.
+bool numaMemory_bind(void *memory, size_t size, int node);
+bool numaMemory_interleave(
+    void *memory,
+    size_t size,
+    const int *nodes,
+    size_t nodeAmount
+);
+
+#endif // __NUMA_MEMORY_H__
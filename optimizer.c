@@ -4,22 +4,105 @@
 
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #define UINT64_T_MAX (0xffffffffffffffff)
-#define TWO_PI (2.0 * 3.14159265358979323846264338328)
+#define UNKNOWN_ERROR_DELTA (INT64_MIN)
 
-void _optimizer_drawPixel(
-    uint64_t x,
-    uint64_t y,
-    double intensity,
-    void *argument
-);
+bool _optimizer_allocateReplica(OptimizerReplica *replica, uint64_t imageSize) {
+    DEBUG_ENTER_FUNC();
+    replica->target = planarImage_new(imageSize);
+    replica->pixelWeights = (uint16_t*)calloc(imageSize, sizeof(uint16_t));
+    const bool result = replica->target && replica->pixelWeights;
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+// NUMA mode: the first worker of every node allocates the node's replica
+// and every worker clears its own scratch buffers, so that the pinned
+// workers touch these pages first and the kernel puts them on their node
+void _optimizer_touchNodeMemory(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer*)argument;
+    const WorkerPool *workerPool = self->workerPool;
+    const uint64_t imageWidth = self->sharedData->inputData.header->imageWidth;
+    const size_t nodeSlot = workerPool->nodeSlots[workerIndex];
+    bool isFirstOfNode = true;
+    for (size_t i = 0; i < workerIndex; ++i) {
+        if (workerPool->nodeSlots[i] == nodeSlot) {
+            isFirstOfNode = false;
+            break;
+        }
+    }
+    if (isFirstOfNode) {
+        _optimizer_allocateReplica(
+            &(self->replicas[nodeSlot]), imageWidth * imageWidth
+        );
+    }
+
+    const uint64_t spanCapacity = (
+        LINE_RENDERER_FAN_SIZE * lineRenderer_maxSpanAmount(imageWidth)
+    );
+    memset(
+        (void*)(self->lineSpans + workerIndex * spanCapacity), 0,
+        spanCapacity * sizeof(LineSpan)
+    );
+    memset(
+        (void*)(self->linePixelIndices + workerIndex * self->linePixelCapacity),
+        0, self->linePixelCapacity * sizeof(uint32_t)
+    );
+    memset(
+        (void*)(self->lineCoverages + workerIndex * self->linePixelCapacity),
+        0, self->linePixelCapacity * sizeof(uint8_t)
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+// NUMA mode: the committed images are read by all workers and written by
+// the main thread when it commits a line (by the workers only once, in the
+// initialization pass), so no node owns them and they are spread over the
+// nodes of the workers
+void _optimizer_interleaveImages(Optimizer *optimizer) {
+    DEBUG_ENTER_FUNC();
+    const WorkerPool *workerPool = optimizer->workerPool;
+    const uint64_t imageWidth = (
+        optimizer->sharedData->inputData.header->imageWidth
+    );
+    const uint64_t imageSize = imageWidth * imageWidth;
+    const PlanarImage *lastBestImage = optimizer->lastBestImage;
+    bool isInterleaved = true;
+    isInterleaved &= numaMemory_interleave(
+        lastBestImage->c, imageSize, workerPool->nodes, workerPool->nodeAmount
+    );
+    isInterleaved &= numaMemory_interleave(
+        lastBestImage->m, imageSize, workerPool->nodes, workerPool->nodeAmount
+    );
+    isInterleaved &= numaMemory_interleave(
+        lastBestImage->y, imageSize, workerPool->nodes, workerPool->nodeAmount
+    );
+    isInterleaved &= numaMemory_interleave(
+        optimizer->lastBestErrorImage, imageSize * sizeof(uint64_t),
+        workerPool->nodes, workerPool->nodeAmount
+    );
+    if (!isInterleaved) {
+        PRINT_ERROR("error while interleaving images over the NUMA nodes, keeping them where they are");
+    }
+    DEBUG_EXIT_FUNC();
+}
 
-Optimizer * _optimizer_construct(SharedData *sharedData) {
+// an optimizer with a parent runs on the parent's worker pool and task
+// group instead of pinning a second pool to the same cores
+Optimizer * _optimizer_construct(SharedData *sharedData, Optimizer *parent) {
     DEBUG_ENTER_FUNC();
     const uint64_t imageWidth = sharedData->inputData.header->imageWidth;
     const uint64_t imageSize = imageWidth * imageWidth;
-    const size_t workerAmount = 1; //workerPool_coreAmount();  #FIXME
+    const size_t workerAmount = (
+        parent ? parent->workerPool->workerAmount : workerPool_coreAmount()
+    );
     const Indexer *indexer = &(sharedData->inputData.header->indexer);
 
     DEBUG_PRINT("workerAmount: %ld\n", workerAmount);
@@ -32,10 +115,41 @@ Optimizer * _optimizer_construct(SharedData *sharedData) {
     }
 
     optimizer->sharedData = sharedData;
+    optimizer->lineKernels = lineKernels_select();
+
+    if (parent) {
+        optimizer->parent = parent;
+        optimizer->workerPool = parent->workerPool;
+        optimizer->taskGroup = parent->taskGroup;
+    } else {
+        optimizer->workerPool = workerPool_new(workerAmount, true);
+        if (!optimizer->workerPool) {
+            PRINT_ERROR("error while constructing optimizer->workerPool");
+            goto ERROR;
+        }
+        // the pool lives as long as the optimizer, so that initialization,
+        // the iterations and the output share the same workers
+        workerPool_start(optimizer->workerPool);
+
+        optimizer->taskGroup = workerPoolTaskGroup_new(2);
+        if (!optimizer->taskGroup) {
+            PRINT_ERROR("error while constructing optimizer->taskGroup");
+            goto ERROR;
+        }
+    }
+    workerPool_setArgument(optimizer->workerPool, (void*)optimizer);
+
+    optimizer->workerResults = (OptimizerWorkerResult*)aligned_alloc(
+        WORKER_POOL_CACHE_LINE_SIZE, workerAmount * sizeof(OptimizerWorkerResult)
+    );
+    if (!optimizer->workerResults) {
+        PRINT_ERROR("error while allocating optimizer->workerResults");
+        goto ERROR;
+    }
 
-    optimizer->workerPool = workerPool_new(workerAmount, true);
-    if (!optimizer->workerPool) {
-        PRINT_ERROR("error while constructing optimizer->workerPool");
+    optimizer->pinTable = pinTable_new(&(sharedData->inputData));
+    if (!optimizer->pinTable) {
+        PRINT_ERROR("error while constructing optimizer->pinTable");
         goto ERROR;
     }
 
@@ -46,8 +160,14 @@ Optimizer * _optimizer_construct(SharedData *sharedData) {
     }
 
     for (size_t i = 0; i < workerAmount; ++i) {
-        optimizer->lineRenderers[i] = lineRenderer_new(_optimizer_drawPixel);
-        if (!optimizer->lineRenderers[i]) {
+        optimizer->lineRenderers[i] = lineRenderer_new();
+        if (
+            !optimizer->lineRenderers[i]
+            || !lineRenderer_setClipRegion(
+                optimizer->lineRenderers[i], imageWidth,
+                optimizer->pinTable->isCircular
+            )
+        ) {
             char buffer[128];
             snprintf(
                 buffer,
@@ -60,13 +180,13 @@ Optimizer * _optimizer_construct(SharedData *sharedData) {
         }
     }
 
-    optimizer->lastBestImage = (Color*)malloc(imageSize * sizeof(Color));
+    optimizer->lastBestImage = planarImage_new(imageSize);
     if (!optimizer->lastBestImage) {
-        PRINT_ERROR("error while allocating optimizer->lastBestImage");
+        PRINT_ERROR("error while constructing optimizer->lastBestImage");
         goto ERROR;
     }
 
-    optimizer->lastBestErrorImage = (uint64_t*)malloc(imageSize * sizeof(uint64_t));
+    optimizer->lastBestErrorImage = (uint64_t*)calloc(imageSize, sizeof(uint64_t));
     if (!optimizer->lastBestErrorImage) {
         PRINT_ERROR("error while allocating optimizer->lastBestErrorImage");
         goto ERROR;
@@ -74,22 +194,75 @@ Optimizer * _optimizer_construct(SharedData *sharedData) {
 
     DEBUG_PRINT("imageSize: %ld\n", imageSize);
     DEBUG_PRINT("pointAmount: %ld\n", indexer->pointAmount);
-    optimizer->imageBuffer = (Color*)malloc(
-        imageSize * indexer->pointAmount * sizeof(Color)
+    double maxThicknessInMicrometers = 0.0;
+    for (uint64_t i = 0; i < indexer->threadAmount; ++i) {
+        const double thicknessInMicrometers = (double)(
+            sharedData->inputData.threads[i].thicknessInMicrometers
+        );
+        if (thicknessInMicrometers > maxThicknessInMicrometers) {
+            maxThicknessInMicrometers = thicknessInMicrometers;
+        }
+    }
+    const double maxThicknessInPixels = (
+        maxThicknessInMicrometers
+        * (double)imageWidth
+        / (double)(sharedData->inputData.header->disc.radiusInMicrometers * 2)
+    );
+    const uint64_t pixelDeltaCapacity = lineRenderer_maxPixelAmount(
+        imageWidth, maxThicknessInPixels
+    );
+    DEBUG_PRINT("pixelDeltaCapacity: %ld\n", pixelDeltaCapacity);
+
+    // every worker rasterizes one fan of lines at a time
+    optimizer->lineSpans = (LineSpan*)malloc(
+        workerAmount * LINE_RENDERER_FAN_SIZE
+        * lineRenderer_maxSpanAmount(imageWidth) * sizeof(LineSpan)
+    );
+    if (!optimizer->lineSpans) {
+        PRINT_ERROR("error while allocating optimizer->lineSpans");
+        goto ERROR;
+    }
+
+    optimizer->linePixelCapacity = pixelDeltaCapacity;
+    optimizer->linePixelIndices = (uint32_t*)malloc(
+        workerAmount * pixelDeltaCapacity * sizeof(uint32_t)
+    );
+    if (!optimizer->linePixelIndices) {
+        PRINT_ERROR("error while allocating optimizer->linePixelIndices");
+        goto ERROR;
+    }
+
+    optimizer->lineCoverages = (uint8_t*)malloc(
+        workerAmount * pixelDeltaCapacity * sizeof(uint8_t)
     );
-    if (!optimizer->imageBuffer) {
-        PRINT_ERROR("error while allocating optimizer->imageBuffer");
+    if (!optimizer->lineCoverages) {
+        PRINT_ERROR("error while allocating optimizer->lineCoverages");
         goto ERROR;
     }
 
-    optimizer->errorBuffer = (uint64_t*)malloc(
-        imageSize * indexer->pointAmount * sizeof(uint64_t)
+    optimizer->pixelDeltas = (PixelDelta**)calloc(
+        indexer->pointAmount, sizeof(PixelDelta*)
     );
-    if (!optimizer->errorBuffer) {
-        PRINT_ERROR("error while allocating optimizer->errorBuffer");
+    if (!optimizer->pixelDeltas) {
+        PRINT_ERROR("error while allocating optimizer->pixelDeltas");
         goto ERROR;
     }
 
+    for (uint64_t i = 0; i < indexer->pointAmount; ++i) {
+        optimizer->pixelDeltas[i] = pixelDelta_new(pixelDeltaCapacity);
+        if (!optimizer->pixelDeltas[i]) {
+            char buffer[128];
+            snprintf(
+                buffer,
+                sizeof(buffer),
+                "error while constructing optimizer->pixelDeltas[%ld]",
+                i
+            );
+            PRINT_ERROR(buffer);
+            goto ERROR;
+        }
+    }
+
     optimizer->errors = (uint64_t*)malloc(
         indexer->pointAmount * sizeof(uint64_t)
     );
@@ -122,24 +295,57 @@ Optimizer * _optimizer_construct(SharedData *sharedData) {
         goto ERROR;
     }
 
-    optimizer->connectionIsDone = (bool**)malloc(
-        indexer->pointAmount * sizeof(bool*)
+    optimizer->thicknessClasses = (uint64_t*)calloc(
+        indexer->threadAmount, sizeof(uint64_t)
     );
-    if (!optimizer->connectionIsDone) {
-        PRINT_ERROR("error while allocating optimizer->connectionIsDone");
+    if (!optimizer->thicknessClasses) {
+        PRINT_ERROR("error while allocating optimizer->thicknessClasses");
         goto ERROR;
     }
 
-    for (uint64_t i = 0; i < indexer->pointAmount; ++i) {
-        optimizer->connectionIsDone[i] = (bool*)calloc(
-            indexer->pointAmount, sizeof(bool)
+    optimizer->mixWeights = (uint32_t*)malloc(
+        indexer->threadAmount * (UINT8_MAX + 1) * sizeof(uint32_t)
+    );
+    if (!optimizer->mixWeights) {
+        PRINT_ERROR("error while allocating optimizer->mixWeights");
+        goto ERROR;
+    }
+
+    optimizer->replicaAmount = (
+        sharedData->inputData.header->optimizationFlags & OPTIMIZATION_NUMA
+        ? optimizer->workerPool->nodeAmount
+        : 1
+    );
+    optimizer->replicas = (OptimizerReplica*)calloc(
+        optimizer->replicaAmount, sizeof(OptimizerReplica)
+    );
+    if (!optimizer->replicas) {
+        PRINT_ERROR("error while allocating optimizer->replicas");
+        goto ERROR;
+    }
+    // replica 0 is the optimizer's own target and weights, on the node of
+    // worker 0 in NUMA mode
+    if (optimizer->replicaAmount > 1) {
+        workerPool_setActiveWorkerAmount(
+            optimizer->workerPool, optimizer->workerPool->workerAmount
         );
-        if (!optimizer->connectionIsDone[i]) {
+        workerPool_setTask(optimizer->workerPool, _optimizer_touchNodeMemory);
+        workerPool_runTask(optimizer->workerPool);
+    } else {
+        _optimizer_allocateReplica(&(optimizer->replicas[0]), imageSize);
+    }
+    optimizer->target = optimizer->replicas[0].target;
+    optimizer->pixelWeights = optimizer->replicas[0].pixelWeights;
+    for (size_t i = 0; i < optimizer->replicaAmount; ++i) {
+        if (
+            !optimizer->replicas[i].target
+            || !optimizer->replicas[i].pixelWeights
+        ) {
             char buffer[128];
             snprintf(
                 buffer,
                 sizeof(buffer),
-                "error while allocating optimizer->connectionIsDone[%ld]",
+                "error while constructing optimizer->replicas[%ld]",
                 i
             );
             PRINT_ERROR(buffer);
@@ -147,6 +353,125 @@ Optimizer * _optimizer_construct(SharedData *sharedData) {
         }
     }
 
+    optimizer->pixelDeltaIsCurrent = (bool*)calloc(
+        indexer->pointAmount, sizeof(bool)
+    );
+    if (!optimizer->pixelDeltaIsCurrent) {
+        PRINT_ERROR("error while allocating optimizer->pixelDeltaIsCurrent");
+        goto ERROR;
+    }
+
+    const uint8_t optimizationFlags = sharedData->inputData.header->optimizationFlags;
+    if (optimizationFlags & OPTIMIZATION_LAZY_GREEDY) {
+        optimizer->candidateQueue = candidateQueue_new(indexer->pointAmount);
+        if (!optimizer->candidateQueue) {
+            PRINT_ERROR("error while constructing optimizer->candidateQueue");
+            goto ERROR;
+        }
+    }
+
+    if (optimizationFlags & (OPTIMIZATION_LAZY_GREEDY | OPTIMIZATION_SPATIAL_INDEX)) {
+        optimizer->pendingEvaluations = (uint64_t*)malloc(
+            indexer->pointAmount * sizeof(uint64_t)
+        );
+        if (!optimizer->pendingEvaluations) {
+            PRINT_ERROR("error while allocating optimizer->pendingEvaluations");
+            goto ERROR;
+        }
+
+        const uint64_t cacheSize = (
+            indexer->threadAmount * indexer_pairAmount(indexer)
+        );
+        optimizer->cachedErrorDeltas = (int64_t*)malloc(
+            cacheSize * sizeof(int64_t)
+        );
+        if (!optimizer->cachedErrorDeltas) {
+            PRINT_ERROR("error while allocating optimizer->cachedErrorDeltas");
+            goto ERROR;
+        }
+
+        optimizer->cachedErrorDeltaIsExact = (bool*)calloc(
+            cacheSize, sizeof(bool)
+        );
+        if (!optimizer->cachedErrorDeltaIsExact) {
+            PRINT_ERROR("error while allocating optimizer->cachedErrorDeltaIsExact");
+            goto ERROR;
+        }
+    }
+
+    optimizer->connectionMatrix = connectionMatrix_new(indexer->pointAmount);
+    if (!optimizer->connectionMatrix) {
+        PRINT_ERROR("error while allocating optimizer->connectionMatrix");
+        goto ERROR;
+    }
+
+    const BeamSearch *beamSearch = &(sharedData->inputData.header->beamSearch);
+    optimizer->beamWidth = beamSearch->width > 1 ? beamSearch->width : 1;
+    optimizer->beamDepth = beamSearch->depth > 1 ? beamSearch->depth : 1;
+    if (optimizer->beamWidth > 1 || optimizer->beamDepth > 1) {
+        DEBUG_PRINT(
+            "beamWidth: %ld, beamDepth: %ld\n",
+            optimizer->beamWidth, optimizer->beamDepth
+        );
+        // parents and children of one level, plus the root state
+        const uint64_t beamStateAmount = 2 * optimizer->beamWidth + 1;
+        optimizer->beamStates = (BeamState*)calloc(
+            beamStateAmount, sizeof(BeamState)
+        );
+        if (!optimizer->beamStates) {
+            PRINT_ERROR("error while allocating optimizer->beamStates");
+            goto ERROR;
+        }
+
+        for (uint64_t i = 0; i < beamStateAmount; ++i) {
+            BeamState *beamState = &(optimizer->beamStates[i]);
+            beamState->overlay = pixelOverlay_new(
+                optimizer->beamDepth * pixelDeltaCapacity
+            );
+            beamState->lastPointIndices = (uint64_t*)malloc(
+                indexer->threadAmount * sizeof(uint64_t)
+            );
+            beamState->moves = (Instruction*)malloc(
+                optimizer->beamDepth * sizeof(Instruction)
+            );
+            if (
+                !beamState->overlay
+                || !beamState->lastPointIndices
+                || !beamState->moves
+            ) {
+                char buffer[128];
+                snprintf(
+                    buffer,
+                    sizeof(buffer),
+                    "error while constructing optimizer->beamStates[%ld]",
+                    i
+                );
+                PRINT_ERROR(buffer);
+                goto ERROR;
+            }
+        }
+
+        optimizer->beamCandidates = (BeamCandidate*)malloc(
+            optimizer->beamWidth * indexer->pointAmount * sizeof(BeamCandidate)
+        );
+        if (!optimizer->beamCandidates) {
+            PRINT_ERROR("error while allocating optimizer->beamCandidates");
+            goto ERROR;
+        }
+
+        optimizer->beamPartners = (uint64_t*)malloc(
+            indexer->pointAmount * sizeof(uint64_t)
+        );
+        if (!optimizer->beamPartners) {
+            PRINT_ERROR("error while allocating optimizer->beamPartners");
+            goto ERROR;
+        }
+    }
+
+    if (optimizer->replicaAmount > 1) {
+        _optimizer_interleaveImages(optimizer);
+    }
+
     DEBUG_EXIT_FUNC();
     return optimizer;
 
@@ -156,11 +481,109 @@ ERROR:
     return NULL;
 }
 
+void _optimizer_buildLineAtlas(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer*)argument;
+    const Indexer *indexer = &(self->sharedData->inputData.header->indexer);
+    self->lineAtlas = lineAtlas_new(
+        self->sharedData->inputData.header->imageWidth, indexer, self->pinTable,
+        self->thicknessesInPixels, indexer->threadAmount
+    );
+    if (self->lineAtlas) {
+        for (uint64_t i = 0; i < indexer->threadAmount; ++i) {
+            self->thicknessClasses[i] = lineAtlas_thicknessClass(
+                self->lineAtlas, self->thicknessesInPixels[i]
+            );
+        }
+    } else {
+        PRINT_ERROR("error while constructing line atlas, rasterizing lines instead");
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_buildSpatialIndex(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer*)argument;
+    const Indexer *indexer = &(self->sharedData->inputData.header->indexer);
+    double maxThicknessInPixels = 0.0;
+    for (uint64_t i = 0; i < indexer->threadAmount; ++i) {
+        if (self->thicknessesInPixels[i] > maxThicknessInPixels) {
+            maxThicknessInPixels = self->thicknessesInPixels[i];
+        }
+    }
+    self->spatialIndex = spatialIndex_new(
+        self->sharedData->inputData.header->imageWidth, indexer,
+        self->pinTable, maxThicknessInPixels
+    );
+    if (!self->spatialIndex) {
+        PRINT_ERROR("error while constructing spatial index, invalidating all cached errors instead");
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+// weights, target and background of the pixels begin .. end - 1, the error
+// is summed per worker
+void _optimizer_initializePixels(
+    void *argument,
+    size_t begin,
+    size_t end,
+    size_t workerIndex
+) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer*)argument;
+    const InputData *inputData = &(self->sharedData->inputData);
+    const uint64_t imageWidth = inputData->header->imageWidth;
+    const uint64_t imageRadius = imageWidth / 2;
+    const Color *backgroundColor = &(inputData->header->disc.backgroundColor);
+
+    // errors are kept in weight units, the importance scale is only
+    // applied to the output
+    for (uint64_t i = begin; i < end; ++i) {
+        self->pixelWeights[i] = inputData_importanceWeight(inputData, i);
+    }
+
+    // the optimizer works on planar images, packed colors are only read
+    // and written at the shared memory boundary
+    planarImage_unpackRange(self->target, inputData->target, begin, end);
+
+    uint64_t errorSum = 0;
+    for (uint64_t i = begin; i < end; ++i) {
+        const int64_t dx = (int64_t)(i % imageWidth) - (int64_t)imageRadius;
+        const int64_t dy = (int64_t)(i / imageWidth) - (int64_t)imageRadius;
+        if (
+            self->pinTable->isCircular
+            && (uint64_t)(dx * dx + dy * dy) > imageRadius * imageRadius
+        ) continue;
+
+        // draw background
+        planarImage_set(self->lastBestImage, i, backgroundColor);
+
+        // calculate error
+        Color targetColor = COLOR_NULL;
+        planarImage_get(self->target, i, &targetColor);
+        const uint64_t error = color_weightedSquaredErrorFixed(
+            &targetColor, backgroundColor, self->pixelWeights[i]
+        );
+
+        errorSum += error;
+        self->lastBestErrorImage[i] = error;
+    }
+    self->workerResults[workerIndex].errorSum += errorSum;
+    DEBUG_EXIT_FUNC();
+}
+
 Optimizer * _optimizer_initialize(Optimizer *self, SharedData *sharedData) {
     DEBUG_ENTER_FUNC();
     const Indexer *indexer = &(sharedData->inputData.header->indexer);
     const uint64_t imageWidth = sharedData->inputData.header->imageWidth;
-    const uint64_t imageRadius = imageWidth / 2;
     const Disc *disc = &(sharedData->inputData.header->disc);
 
     for (uint64_t i = 0; i < indexer->threadAmount; ++i) {
@@ -172,28 +595,53 @@ Optimizer * _optimizer_initialize(Optimizer *self, SharedData *sharedData) {
         );
     }
 
-    uint64_t errorSum = 0;
-    for (uint64_t y = 0; y < imageWidth; ++y) {
-        for (uint64_t x = 0; x < imageWidth; ++x) {
-            if (x * x + y * y > imageRadius * imageRadius) continue;
-
-            // draw background
-            self->lastBestImage[imageWidth * y + x] = (
-                sharedData->inputData.header->disc.backgroundColor
+    // alpha times coverage, both 8 bit, as a 16 bit fixed point mix weight
+    for (uint64_t i = 0; i < indexer->threadAmount; ++i) {
+        const uint64_t alpha = sharedData->inputData.threads[i].alpha;
+        for (uint64_t coverage = 0; coverage <= UINT8_MAX; ++coverage) {
+            self->mixWeights[i * (UINT8_MAX + 1) + coverage] = (uint32_t)(
+                (alpha * coverage * COLOR_MIX_WEIGHT_ONE + UINT8_MAX * UINT8_MAX / 2)
+                / (UINT8_MAX * UINT8_MAX)
             );
+        }
+    }
 
-            // calculate error
-            const uint64_t error = color_weightedSquaredError(
-                &sharedData->inputData.target[imageWidth * y + x],
-                &sharedData->inputData.header->disc.backgroundColor,
-                self->sharedData->inputData.importance[imageWidth * y + x]
-            );
+    // the line atlas and the spatial index only depend on the pins and
+    // thicknesses, they are built side by side on two workers
+    workerPoolTaskGroup_clear(self->taskGroup);
+    if (sharedData->inputData.header->optimizationFlags & OPTIMIZATION_LINE_ATLAS) {
+        workerPoolTaskGroup_add(
+            self->taskGroup, _optimizer_buildLineAtlas, (void*)self
+        );
+    }
+    if (sharedData->inputData.header->optimizationFlags & OPTIMIZATION_SPATIAL_INDEX) {
+        workerPoolTaskGroup_add(
+            self->taskGroup, _optimizer_buildSpatialIndex, (void*)self
+        );
+    }
+    workerPool_runTaskGroup(self->workerPool, self->taskGroup);
+
+    for (size_t i = 0; i < self->workerPool->workerAmount; ++i) {
+        self->workerResults[i].errorSum = 0;
+    }
+    workerPool_parallelFor(
+        self->workerPool, 0, imageWidth * imageWidth,
+        OPTIMIZER_PIXEL_CHUNK_SIZE, _optimizer_initializePixels, (void*)self
+    );
+    // integer sums, so the total is exact however the pixels were split
+    self->lastBestError = 0;
+    for (size_t i = 0; i < self->workerPool->workerAmount; ++i) {
+        self->lastBestError += self->workerResults[i].errorSum;
+    }
 
-            errorSum += error;
-            self->lastBestErrorImage[imageWidth * y + x] = error;
+    if (self->cachedErrorDeltas) {
+        const uint64_t cacheSize = (
+            indexer->threadAmount * indexer_pairAmount(indexer)
+        );
+        for (uint64_t i = 0; i < cacheSize; ++i) {
+            self->cachedErrorDeltas[i] = UNKNOWN_ERROR_DELTA;
         }
     }
-    self->lastBestError = errorSum;
 
     memcpy(
         (void*)self->lastBestPointIndices,
@@ -201,145 +649,407 @@ Optimizer * _optimizer_initialize(Optimizer *self, SharedData *sharedData) {
         indexer->threadAmount * sizeof(uint64_t)
     );
 
+    self->replicas[0].lineAtlas = self->lineAtlas;
+    bool isLineAtlasShared = false;
+    for (size_t i = 1; i < self->replicaAmount; ++i) {
+        OptimizerReplica *replica = &(self->replicas[i]);
+        memcpy(replica->target->c, self->target->c, imageWidth * imageWidth);
+        memcpy(replica->target->m, self->target->m, imageWidth * imageWidth);
+        memcpy(replica->target->y, self->target->y, imageWidth * imageWidth);
+        memcpy(
+            replica->pixelWeights, self->pixelWeights,
+            imageWidth * imageWidth * sizeof(uint16_t)
+        );
+        if (self->lineAtlas) {
+            replica->lineAtlas = lineAtlas_replicate(
+                self->lineAtlas, self->workerPool->nodes[i]
+            );
+            if (!replica->lineAtlas) {
+                replica->lineAtlas = self->lineAtlas;
+                isLineAtlasShared = true;
+            }
+        }
+    }
+    if (isLineAtlasShared) {
+        PRINT_ERROR("error while replicating line atlas, sharing it instead");
+    }
+
+    self->tuning.workerAmount = self->workerPool->workerAmount;
+    self->tuning.chunkSize = OPTIMIZER_CANDIDATE_CHUNK_SIZE;
+    self->tuning.bestWorkerAmount = self->tuning.workerAmount;
+    self->tuning.bestChunkSize = self->tuning.chunkSize;
+    self->tuning.ranWorkerAmount = self->tuning.workerAmount;
+    self->tuning.ranChunkSize = self->tuning.chunkSize;
+
     DEBUG_EXIT_FUNC();
     return self;
 }
 
+Optimizer * _optimizer_new(SharedData *sharedData, Optimizer *parent) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *result = _optimizer_construct(sharedData, parent);
+    if (!result) {
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    result = _optimizer_initialize(result, sharedData);
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
 Optimizer * optimizer_new(SharedData *sharedData) {
     DEBUG_ENTER_FUNC();
-    Optimizer *result = _optimizer_initialize(
-        _optimizer_construct(sharedData),
-        sharedData
-    );
+    Optimizer *result = _optimizer_new(sharedData, NULL);
     DEBUG_EXIT_FUNC();
     return result;
 }
 
 void optimizer_delete(Optimizer *self) {
     DEBUG_ENTER_FUNC();
-    for (
-        uint64_t i = 0;
-        i < self->sharedData->inputData.header->indexer.pointAmount;
-        ++i
-    ) {
-        free(self->connectionIsDone[i]);
+    if (!self) {
+        DEBUG_EXIT_FUNC();
+        return;
     }
-    free(self->connectionIsDone);
+    if (self->workerPool && !self->parent) {
+        workerPool_stop(self->workerPool);
+    }
+    free(self->beamPartners);
+    free(self->beamCandidates);
+    if (self->beamStates) {
+        for (uint64_t i = 0; i < 2 * self->beamWidth + 1; ++i) {
+            free(self->beamStates[i].moves);
+            free(self->beamStates[i].lastPointIndices);
+            pixelOverlay_delete(self->beamStates[i].overlay);
+        }
+    }
+    free(self->beamStates);
+    connectionMatrix_delete(self->connectionMatrix);
+    free(self->cachedErrorDeltaIsExact);
+    free(self->cachedErrorDeltas);
+    free(self->pendingEvaluations);
+    spatialIndex_delete(self->spatialIndex);
+    candidateQueue_delete(self->candidateQueue);
+    free(self->pixelDeltaIsCurrent);
+    for (size_t i = 1; self->replicas && i < self->replicaAmount; ++i) {
+        planarImage_delete(self->replicas[i].target);
+        free(self->replicas[i].pixelWeights);
+        if (self->replicas[i].lineAtlas != self->lineAtlas) {
+            lineAtlas_delete(self->replicas[i].lineAtlas);
+        }
+    }
+    free(self->replicas);
+    free(self->mixWeights);
+    free(self->pixelWeights);
+    free(self->thicknessClasses);
     free(self->thicknessesInPixels);
     free(self->possibleConnections);
     free(self->lastBestPointIndices);
     free(self->errors);
-    free(self->errorBuffer);
+    if (self->pixelDeltas) {
+        for (
+            uint64_t i = 0;
+            i < self->sharedData->inputData.header->indexer.pointAmount;
+            ++i
+        ) {
+            pixelDelta_delete(self->pixelDeltas[i]);
+        }
+    }
+    free(self->pixelDeltas);
+    free(self->lineCoverages);
+    free(self->linePixelIndices);
+    free(self->lineSpans);
     free(self->lastBestErrorImage);
-    free(self->imageBuffer);
-    free(self->lastBestImage);
+    planarImage_delete(self->lastBestImage);
+    planarImage_delete(self->target);
     for (
         uint64_t i = 0;
-        i < self->workerPool->workerAmount;
+        self->lineRenderers && i < self->workerPool->workerAmount;
         ++i
     ) {
         lineRenderer_delete(self->lineRenderers[i]);
     }
     free(self->lineRenderers);
-    workerPool_delete(self->workerPool);
+    lineAtlas_delete(self->lineAtlas);
+    pinTable_delete(self->pinTable);
+    free(self->workerResults);
+    if (self->parent) {
+        // the pool goes back to the parent as the parent left it
+        workerPool_setArgument(self->workerPool, (void*)(self->parent));
+        workerPool_setActiveWorkerAmount(
+            self->workerPool, self->parent->tuning.workerAmount
+        );
+    } else {
+        workerPoolTaskGroup_delete(self->taskGroup);
+        workerPool_delete(self->workerPool);
+    }
     free(self);
     DEBUG_EXIT_FUNC();
 }
 
-typedef struct {
-    Optimizer *optimizer;
-    uint64_t pointIndex;
-    size_t workerIndex;
-} DrawPixelArgument;
-
-void _optimizer_drawPixel(
-    uint64_t x,
-    uint64_t y,
-    double intensity,
-    void *argument
+typedef void (*PixelVisitor)(
+    Optimizer *self,
+    void *context,
+    uint64_t imageIndex,
+    uint8_t coverage
+);
+
+// the replica on the memory node of a worker
+const OptimizerReplica * _optimizer_replica(
+    const Optimizer *self,
+    uint64_t workerIndex
 ) {
     DEBUG_ENTER_FUNC();
-    Optimizer *self = ((DrawPixelArgument*)argument)->optimizer;
-    const uint64_t pointIndex = ((DrawPixelArgument*)argument)->pointIndex;
-    const Thread *thread = &(
-        self->sharedData->inputData.threads[self->currentThreadIndex]
-    );
-    const uint64_t imageWidth = (
-        self->sharedData->inputData.header->imageWidth
-    );
-    const uint64_t imageSize = imageWidth * imageWidth;
-    const uint64_t imageIndex = y * imageWidth + x;
-    const uint64_t bufferIndex = pointIndex * imageSize + imageIndex;
-
-    if (x < 0 || y < 0 || x >= imageWidth || y >= imageWidth) {
-        DEBUG_EXIT_FUNC();
-        return;
-    }
-
-    const Color oldColor = self->lastBestImage[imageIndex];
-    const double alpha = (double)(thread->alpha) / (double)0xff;
-    Color newColor = COLOR_NULL;
-    color_mix(&oldColor, &(thread->color), alpha * intensity, &newColor);
+    const OptimizerReplica *result = &(self->replicas[
+        self->replicaAmount > 1
+        ? self->workerPool->nodeSlots[workerIndex]
+        : 0
+    ]);
+    DEBUG_EXIT_FUNC();
+    return result;
+}
 
-    const Color targetColor = (
-        self->sharedData->inputData.target[imageIndex]
+uint64_t _optimizer_mixPixel(
+    Optimizer *self,
+    const OptimizerReplica *replica,
+    uint64_t threadIndex,
+    uint64_t imageIndex,
+    const Color *oldColor,
+    uint8_t coverage,
+    Color *newColor
+) {
+    DEBUG_ENTER_FUNC();
+    const Thread *thread = &(self->sharedData->inputData.threads[threadIndex]);
+    color_mixFixed(
+        oldColor, &(thread->color),
+        self->mixWeights[threadIndex * (UINT8_MAX + 1) + coverage],
+        newColor
     );
 
-    const uint64_t newError = color_weightedSquaredError(
-        &targetColor, &newColor,
-        self->sharedData->inputData.importance[imageIndex]
-    );
-    const uint64_t oldError = self->lastBestErrorImage[imageIndex];
+    Color targetColor = COLOR_NULL;
+    planarImage_get(replica->target, imageIndex, &targetColor);
 
-    self->errors[pointIndex] -= oldError;
-    self->errors[pointIndex] += newError;
-    self->errorBuffer[bufferIndex] = newError;
-    self->imageBuffer[bufferIndex] = newColor;
+    const uint64_t newError = color_weightedSquaredErrorFixed(
+        &targetColor, newColor, replica->pixelWeights[imageIndex]
+    );
     DEBUG_EXIT_FUNC();
+    return newError;
 }
 
-void _optimizer_drawLine(
+uint64_t _optimizer_lineSpans(
     Optimizer *optimizer,
     uint64_t workerIndex,
+    uint64_t threadIndex,
     uint64_t startIndex,
-    uint64_t endIndex
+    uint64_t endIndex,
+    const LineSpan **spans
 ) {
     DEBUG_ENTER_FUNC();
-    DEBUG_PRINT("wid: %ld, s: %ld, e: %ld\n", workerIndex, startIndex, endIndex);
-    const Indexer *indexer = &(
-        optimizer->sharedData->inputData.header->indexer
-    );
-    const double startAngle = (
-        TWO_PI * (double)startIndex / (double)(indexer->pointAmount)
-    );
-    const double endAngle = (
-        TWO_PI * (double)endIndex / (double)(indexer->pointAmount)
-    );
     const uint64_t imageWidth = optimizer->sharedData->inputData.header->imageWidth;
-    const double imageRadius = (double)imageWidth / 2.0;
-    const double x0 = cos(startAngle) * imageRadius + imageRadius;
-    const double y0 = (double)imageWidth - (sin(startAngle) * imageRadius + imageRadius);
-    const double x1 = cos(endAngle) * imageRadius + imageRadius;
-    const double y1 = (double)imageWidth - (sin(endAngle) * imageRadius + imageRadius);
-
-    lineRenderer_setArgument(
-        optimizer->lineRenderers[workerIndex],
-        (void*)&(DrawPixelArgument){
-            .optimizer = optimizer,
-            .pointIndex = endIndex,
-            .workerIndex = workerIndex
-        }
-    );
+    double x0 = 0.0;
+    double y0 = 0.0;
+    double x1 = 0.0;
+    double y1 = 0.0;
+    pinTable_position(optimizer->pinTable, startIndex, &x0, &y0);
+    pinTable_position(optimizer->pinTable, endIndex, &x1, &y1);
 
-    const double thicknessInPixels = (
-        optimizer->thicknessesInPixels[optimizer->currentThreadIndex]
+    LineSpan *lineSpans = (
+        optimizer->lineSpans
+        + workerIndex * LINE_RENDERER_FAN_SIZE
+        * lineRenderer_maxSpanAmount(imageWidth)
     );
-
-    lineRenderer_draw(
+    const uint64_t spanAmount = lineRenderer_drawSpansFixed(
         optimizer->lineRenderers[workerIndex],
-        x0, y0, x1, y1, thicknessInPixels
+        x0, y0, x1, y1, optimizer->thicknessesInPixels[threadIndex],
+        lineSpans
     );
+    *spans = lineSpans;
+    DEBUG_EXIT_FUNC();
+    return spanAmount;
+}
+
+uint64_t _optimizer_linePixels(
+    Optimizer *optimizer,
+    uint64_t workerIndex,
+    uint64_t threadIndex,
+    uint64_t startIndex,
+    uint64_t endIndex,
+    const uint32_t **pixelIndices,
+    const uint8_t **coverages
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_PRINT("wid: %ld, s: %ld, e: %ld\n", workerIndex, startIndex, endIndex);
+    const LineAtlas *lineAtlas = _optimizer_replica(
+        optimizer, workerIndex
+    )->lineAtlas;
+    if (lineAtlas) {
+        const uint64_t pixelAmount = lineAtlas_line(
+            lineAtlas,
+            optimizer->thicknessClasses[threadIndex],
+            startIndex, endIndex,
+            pixelIndices, coverages
+        );
+        DEBUG_EXIT_FUNC();
+        return pixelAmount;
+    }
+
+    const LineSpan *spans = NULL;
+    const uint64_t spanAmount = _optimizer_lineSpans(
+        optimizer, workerIndex, threadIndex, startIndex, endIndex, &spans
+    );
+
+    uint32_t *linePixelIndices = (
+        optimizer->linePixelIndices
+        + workerIndex * optimizer->linePixelCapacity
+    );
+    uint8_t *lineCoverages = (
+        optimizer->lineCoverages
+        + workerIndex * optimizer->linePixelCapacity
+    );
+    const uint64_t pixelAmount = lineRenderer_expandSpans(
+        spans, spanAmount, linePixelIndices, lineCoverages
+    );
+    DEBUG_ASSERT(
+        pixelAmount <= optimizer->linePixelCapacity,
+        "line pixel capacity exceeded."
+    );
+    *pixelIndices = linePixelIndices;
+    *coverages = lineCoverages;
+    DEBUG_EXIT_FUNC();
+    return pixelAmount;
+}
+
+void _optimizer_visitLine(
+    Optimizer *optimizer,
+    uint64_t workerIndex,
+    uint64_t threadIndex,
+    uint64_t startIndex,
+    uint64_t endIndex,
+    PixelVisitor visitPixel,
+    void *context
+) {
+    DEBUG_ENTER_FUNC();
+    const uint32_t *pixelIndices = NULL;
+    const uint8_t *coverages = NULL;
+    const uint64_t pixelAmount = _optimizer_linePixels(
+        optimizer, workerIndex, threadIndex, startIndex, endIndex,
+        &pixelIndices, &coverages
+    );
+    for (uint64_t i = 0; i < pixelAmount; ++i) {
+        visitPixel(optimizer, context, pixelIndices[i], coverages[i]);
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+// The one order every argmin of the candidates uses: lower error first,
+// then lower pin index. A pin is scored by one worker only, so the order
+// never falls back to the worker and the winner is the same for any worker
+// amount or chunking.
+void _optimizer_offerCandidate(
+    OptimizerCandidateResult *best,
+    uint64_t error,
+    uint64_t pointIndex
+) {
+    DEBUG_ENTER_FUNC();
+    if (
+        best->pointIndex == OPTIMIZER_NO_POINT
+        || error < best->error
+        || (error == best->error && pointIndex < best->pointIndex)
+    ) {
+        best->error = error;
+        best->pointIndex = pointIndex;
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+// the errors of the lines are stored per end pin and the best of them is
+// kept in best, which lives on the calling worker's stack
+void _optimizer_drawLines(
+    Optimizer *optimizer,
+    uint64_t workerIndex,
+    uint64_t startIndex,
+    const uint64_t *endIndices,
+    uint64_t lineAmount,
+    OptimizerCandidateResult *best
+) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t threadIndex = optimizer->currentThreadIndex;
+    const OptimizerReplica *replica = _optimizer_replica(optimizer, workerIndex);
+    const LineScoreInput input = {
+        .target = replica->target,
+        .image = optimizer->lastBestImage,
+        .errorImage = optimizer->lastBestErrorImage,
+        .pixelWeights = replica->pixelWeights,
+        .mixWeights = optimizer->mixWeights + threadIndex * (UINT8_MAX + 1),
+        .color = optimizer->sharedData->inputData.threads[threadIndex].color
+    };
+    if (replica->lineAtlas) {
+        for (uint64_t i = 0; i < lineAmount; ++i) {
+            const uint64_t endIndex = endIndices[i];
+            PixelDelta *pixelDelta = optimizer->pixelDeltas[endIndex];
+            pixelDelta_clear(pixelDelta);
+            const uint32_t *pixelIndices = NULL;
+            const uint8_t *coverages = NULL;
+            const uint64_t pixelAmount = _optimizer_linePixels(
+                optimizer, workerIndex, threadIndex, startIndex, endIndex,
+                &pixelIndices, &coverages
+            );
+            const int64_t errorDelta = optimizer->lineKernels->scoreLine(
+                &input, pixelIndices, coverages, pixelAmount, pixelDelta
+            );
+            const uint64_t error = optimizer->lastBestError + (uint64_t)errorDelta;
+            optimizer->errors[endIndex] = error;
+            optimizer->pixelDeltaIsCurrent[endIndex] = true;
+            _optimizer_offerCandidate(best, error, endIndex);
+        }
+        DEBUG_EXIT_FUNC();
+        return;
+    }
 
+    // all candidates start at the same pin, so they are rasterized as fans
+    // and their spans are scored directly, the per pixel arrays are only
+    // needed by the beam search and the atlas
+    const uint64_t maxSpanAmount = lineRenderer_maxSpanAmount(
+        optimizer->sharedData->inputData.header->imageWidth
+    );
+    LineSpan *spans = (
+        optimizer->lineSpans
+        + workerIndex * LINE_RENDERER_FAN_SIZE * maxSpanAmount
+    );
+    double x0 = 0.0;
+    double y0 = 0.0;
+    pinTable_position(optimizer->pinTable, startIndex, &x0, &y0);
+    for (uint64_t begin = 0; begin < lineAmount; begin += LINE_RENDERER_FAN_SIZE) {
+        const uint64_t fanSize = (
+            lineAmount - begin < LINE_RENDERER_FAN_SIZE
+            ? lineAmount - begin
+            : LINE_RENDERER_FAN_SIZE
+        );
+        double x1[LINE_RENDERER_FAN_SIZE];
+        double y1[LINE_RENDERER_FAN_SIZE];
+        uint64_t spanAmounts[LINE_RENDERER_FAN_SIZE];
+        for (uint64_t i = 0; i < fanSize; ++i) {
+            pinTable_position(
+                optimizer->pinTable, endIndices[begin + i], &(x1[i]), &(y1[i])
+            );
+        }
+        lineRenderer_drawSpanFan(
+            optimizer->lineRenderers[workerIndex],
+            x0, y0, x1, y1, fanSize, optimizer->thicknessesInPixels[threadIndex],
+            spans, maxSpanAmount, spanAmounts
+        );
+        for (uint64_t i = 0; i < fanSize; ++i) {
+            const uint64_t endIndex = endIndices[begin + i];
+            PixelDelta *pixelDelta = optimizer->pixelDeltas[endIndex];
+            pixelDelta_clear(pixelDelta);
+            const int64_t errorDelta = optimizer->lineKernels->scoreSpans(
+                &input, spans + i * maxSpanAmount, spanAmounts[i], pixelDelta
+            );
+            const uint64_t error = optimizer->lastBestError + (uint64_t)errorDelta;
+            optimizer->errors[endIndex] = error;
+            optimizer->pixelDeltaIsCurrent[endIndex] = true;
+            _optimizer_offerCandidate(best, error, endIndex);
+        }
+    }
     DEBUG_EXIT_FUNC();
 }
 
@@ -350,98 +1060,757 @@ void _optimizer_optimizeTask(
 ) {
     DEBUG_ENTER_FUNC();
     Optimizer *self = (Optimizer *const)argument;
-    for (
-        uint64_t i = workerIndex * workerAmount;
-        i < self->possibleConnectionAmount; ++i
-    ) {
-        const uint64_t startIndex = self->lastBestPointIndices[self->currentThreadIndex];
-        const uint64_t endIndex = self->possibleConnections[i];
-
-        _optimizer_drawLine(self, workerIndex, startIndex, endIndex);
-
-        self->connectionIsDone[startIndex][endIndex] = true;
-        self->connectionIsDone[endIndex][startIndex] = true;
+    const uint64_t startIndex = self->lastBestPointIndices[self->currentThreadIndex];
+    OptimizerCandidateResult best = {
+        .error = 0,
+        .pointIndex = OPTIMIZER_NO_POINT
+    };
+    // candidate lines differ a lot in length, so workers claim small chunks
+    // from a shared cursor instead of getting a fixed share
+    while (true) {
+        const uint64_t begin = atomic_fetch_add_explicit(
+            &(self->candidateCursor),
+            self->tuning.chunkSize,
+            memory_order_relaxed
+        );
+        if (begin >= self->evaluationAmount) {
+            break;
+        }
+        uint64_t end = begin + self->tuning.chunkSize;
+        if (end > self->evaluationAmount) {
+            end = self->evaluationAmount;
+        }
+        _optimizer_drawLines(
+            self, workerIndex, startIndex,
+            self->evaluations + begin, end - begin, &best
+        );
     }
+    // published once per task, the main thread reduces the slots
+    self->workerResults[workerIndex].best = best;
     DEBUG_EXIT_FUNC();
 }
 
-void _optimizer_storeDebugInformation(Optimizer *self) {
+void _optimizer_storeDebugRange(
+    void *argument,
+    size_t begin,
+    size_t end,
+    size_t workerIndex
+) {
     DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer*)argument;
     const uint64_t imageWidth = self->sharedData->inputData.header->imageWidth;
     const uint64_t imageSize = imageWidth * imageWidth;
     const uint8_t debugFlags = self->sharedData->inputData.header->debugFlags;
     if (debugFlags & DEBUG_STORE_IMAGES) {
-        memcpy(
-            (void*)self->sharedData->outputData.debugData.images + self->currentIteration * imageSize * self->sharedData->inputData.header->indexer.pointAmount,
-            (void*)self->imageBuffer,
-            imageSize * self->sharedData->inputData.header->indexer.pointAmount
+        planarImage_packRange(
+            self->lastBestImage,
+            self->sharedData->outputData.debugData.images + self->currentIteration * imageSize,
+            begin, end
         );
     }
     if (debugFlags & DEBUG_STORE_ABSOLUTE_ERROR) {
-        memcpy(
-            (void*)self->sharedData->outputData.debugData.absoluteErrors + self->currentIteration * imageSize * self->sharedData->inputData.header->indexer.pointAmount,
-            (void*)self->errorBuffer,
-            imageSize * self->sharedData->inputData.header->indexer.pointAmount
+        uint64_t *absoluteErrors = (
+            self->sharedData->outputData.debugData.absoluteErrors
+            + self->currentIteration * imageSize
+        );
+        const double scale = (
+            self->sharedData->inputData.header->importanceFormat.scale
         );
+        for (uint64_t i = begin; i < end; ++i) {
+            absoluteErrors[i] = (uint64_t)llround(
+                (double)(self->lastBestErrorImage[i]) * scale
+            );
+        }
     }
     DEBUG_EXIT_FUNC();
 }
 
+void _optimizer_storeDebugInformation(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t imageWidth = self->sharedData->inputData.header->imageWidth;
+    workerPool_parallelFor(
+        self->workerPool, 0, imageWidth * imageWidth,
+        OPTIMIZER_PIXEL_CHUNK_SIZE, _optimizer_storeDebugRange, (void*)self
+    );
+    DEBUG_EXIT_FUNC();
+}
+
 void _optimizer_prepareIteration(Optimizer *self) {
     DEBUG_ENTER_FUNC();
     self->currentThreadIndex = self->sharedData->inputData.threadOrder[self->currentIteration % self->sharedData->inputData.header->threadOrderSize];
     self->possibleConnectionAmount = 0;
+    const uint64_t startIndex = self->lastBestPointIndices[self->currentThreadIndex];
     if (self->sharedData->inputData.header->termination.flags & TERMINATE_ON_UNAVAILABLE_CONNECTION) {
+        self->possibleConnectionAmount = connectionMatrix_availablePartners(
+            self->connectionMatrix, startIndex, self->possibleConnections
+        );
+    } else {
         for (uint64_t i = 0, j = 0; i < self->sharedData->inputData.header->indexer.pointAmount; ++i) {
-            if (self->connectionIsDone[j][self->lastBestPointIndices[self->currentThreadIndex]]) {
-                continue;
-            }
-            if (i == self->lastBestPointIndices[self->currentThreadIndex]) {
+            if (i == startIndex) {
                 continue;
             }
             self->possibleConnections[j++] = i;
             ++(self->possibleConnectionAmount);
         }
+    }
+    memset(
+        (void*)self->pixelDeltaIsCurrent,
+        0,
+        self->sharedData->inputData.header->indexer.pointAmount * sizeof(bool)
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+double _optimizer_seconds(void) {
+    DEBUG_ENTER_FUNC();
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    const double result = (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+// runs a task over workAmount candidates and times it for the tuning
+void _optimizer_runTask(Optimizer *self, Task task, uint64_t workAmount) {
+    DEBUG_ENTER_FUNC();
+    atomic_store_explicit(
+        &(self->candidateCursor), 0, memory_order_relaxed
+    );
+    workerPool_setTask(self->workerPool, task);
+    const double start = _optimizer_seconds();
+    workerPool_runTask(self->workerPool);
+    self->tuning.elapsed += _optimizer_seconds() - start;
+    self->tuning.workAmount += workAmount;
+    self->tuning.ranWorkerAmount = self->tuning.workerAmount;
+    self->tuning.ranChunkSize = self->tuning.chunkSize;
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_applyTuning(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    OptimizerTuning *tuning = &(self->tuning);
+    DEBUG_PRINT(
+        "tuning phase %ld: %ld workers, chunks of %ld\n",
+        tuning->phase, tuning->workerAmount, tuning->chunkSize
+    );
+    workerPool_setActiveWorkerAmount(self->workerPool, tuning->workerAmount);
+    tuning->iterationAmount = 0;
+    tuning->elapsed = 0.0;
+    tuning->workAmount = 0;
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_startTuning(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    OptimizerTuning *tuning = &(self->tuning);
+    tuning->phase = OPTIMIZER_TUNING_WORKERS;
+    tuning->workerAmount = self->workerPool->workerAmount;
+    tuning->chunkSize = OPTIMIZER_CANDIDATE_CHUNK_SIZE;
+    tuning->bestWorkerAmount = tuning->workerAmount;
+    tuning->bestChunkSize = tuning->chunkSize;
+    tuning->bestTime = INFINITY;
+    tuning->lockedTime = 0.0;
+    _optimizer_applyTuning(self);
+    DEBUG_EXIT_FUNC();
+}
+
+// moves on to the next configuration once the current one was timed
+void _optimizer_tune(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    OptimizerTuning *tuning = &(self->tuning);
+    ++(tuning->iterationAmount);
+    const uint64_t iterationAmount = (
+        tuning->phase == OPTIMIZER_TUNING_LOCKED
+        ? OPTIMIZER_TUNING_INTERVAL
+        : OPTIMIZER_TUNING_ITERATIONS
+    );
+    if (tuning->iterationAmount < iterationAmount || tuning->workAmount == 0) {
+        DEBUG_EXIT_FUNC();
+        return;
+    }
+    const double time = tuning->elapsed / (double)(tuning->workAmount);
+
+    if (tuning->phase == OPTIMIZER_TUNING_LOCKED) {
+        if (
+            time > tuning->lockedTime * OPTIMIZER_TUNING_DRIFT
+            || time * OPTIMIZER_TUNING_DRIFT < tuning->lockedTime
+        ) {
+            _optimizer_startTuning(self);
+        } else {
+            tuning->iterationAmount = 0;
+            tuning->elapsed = 0.0;
+            tuning->workAmount = 0;
+        }
+        DEBUG_EXIT_FUNC();
+        return;
+    }
+
+    const bool isBetter = time < tuning->bestTime;
+    if (isBetter) {
+        tuning->bestTime = time;
+        tuning->bestWorkerAmount = tuning->workerAmount;
+        tuning->bestChunkSize = tuning->chunkSize;
+    }
+    if (tuning->phase == OPTIMIZER_TUNING_WORKERS) {
+        if (isBetter && tuning->workerAmount > 1) {
+            tuning->workerAmount /= 2;
+            _optimizer_applyTuning(self);
+            DEBUG_EXIT_FUNC();
+            return;
+        }
+        tuning->phase = OPTIMIZER_TUNING_CHUNKS;
+        tuning->workerAmount = tuning->bestWorkerAmount;
+        tuning->chunkSize = OPTIMIZER_MIN_CANDIDATE_CHUNK_SIZE;
     } else {
-        for (uint64_t i = 0, j = 0; i < self->sharedData->inputData.header->indexer.pointAmount; ++i) {
-            if (i == self->lastBestPointIndices[self->currentThreadIndex]) {
+        tuning->chunkSize *= 2;
+    }
+    // the default chunk size was timed along with the worker amounts
+    if (tuning->chunkSize == OPTIMIZER_CANDIDATE_CHUNK_SIZE) {
+        tuning->chunkSize *= 2;
+    }
+    // chunks only balance the load between workers, a single worker
+    // rasterizes the same fans whatever it claims
+    if (
+        tuning->chunkSize > OPTIMIZER_MAX_CANDIDATE_CHUNK_SIZE
+        || tuning->workerAmount == 1
+    ) {
+        tuning->phase = OPTIMIZER_TUNING_LOCKED;
+        tuning->workerAmount = tuning->bestWorkerAmount;
+        tuning->chunkSize = tuning->bestChunkSize;
+        tuning->lockedTime = tuning->bestTime;
+    }
+    _optimizer_applyTuning(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_evaluate(
+    Optimizer *self,
+    uint64_t *evaluations,
+    uint64_t evaluationAmount
+) {
+    DEBUG_ENTER_FUNC();
+    self->evaluations = evaluations;
+    self->evaluationAmount = evaluationAmount;
+    _optimizer_runTask(self, _optimizer_optimizeTask, evaluationAmount);
+    DEBUG_EXIT_FUNC();
+}
+
+// merges the best candidates of the workers of the last evaluation into best
+void _optimizer_reduceCandidates(
+    const Optimizer *self,
+    OptimizerCandidateResult *best
+) {
+    DEBUG_ENTER_FUNC();
+    for (size_t i = 0; i < self->workerPool->activeWorkerAmount; ++i) {
+        const OptimizerCandidateResult *workerBest = &(
+            self->workerResults[i].best
+        );
+        if (workerBest->pointIndex != OPTIMIZER_NO_POINT) {
+            _optimizer_offerCandidate(
+                best, workerBest->error, workerBest->pointIndex
+            );
+        }
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_cacheEvaluations(
+    Optimizer *self,
+    const uint64_t *evaluations,
+    uint64_t evaluationAmount
+) {
+    DEBUG_ENTER_FUNC();
+    const Indexer *indexer = &(self->sharedData->inputData.header->indexer);
+    const uint64_t startIndex = self->lastBestPointIndices[self->currentThreadIndex];
+    const uint64_t cacheOffset = (
+        self->currentThreadIndex * indexer_pairAmount(indexer)
+    );
+    for (uint64_t i = 0; i < evaluationAmount; ++i) {
+        const uint64_t pointIndex = evaluations[i];
+        const uint64_t cacheIndex = (
+            cacheOffset + indexer_pairIndex(indexer, startIndex, pointIndex)
+        );
+        self->cachedErrorDeltas[cacheIndex] = (int64_t)(
+            self->errors[pointIndex] - self->lastBestError
+        );
+        self->cachedErrorDeltaIsExact[cacheIndex] = true;
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_evaluateExhaustively(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    OptimizerCandidateResult best = {
+        .error = 0,
+        .pointIndex = OPTIMIZER_NO_POINT
+    };
+    if (self->cachedErrorDeltas) {
+        // reuse exact cached errors, evaluate only the invalidated lines
+        const Indexer *indexer = &(self->sharedData->inputData.header->indexer);
+        const uint64_t startIndex = self->lastBestPointIndices[self->currentThreadIndex];
+        const uint64_t cacheOffset = (
+            self->currentThreadIndex * indexer_pairAmount(indexer)
+        );
+        uint64_t evaluationAmount = 0;
+        for (uint64_t i = 0; i < self->possibleConnectionAmount; ++i) {
+            const uint64_t pointIndex = self->possibleConnections[i];
+            const uint64_t cacheIndex = (
+                cacheOffset + indexer_pairIndex(indexer, startIndex, pointIndex)
+            );
+            if (self->cachedErrorDeltaIsExact[cacheIndex]) {
+                self->errors[pointIndex] = (
+                    self->lastBestError
+                    + (uint64_t)(self->cachedErrorDeltas[cacheIndex])
+                );
+                _optimizer_offerCandidate(
+                    &best, self->errors[pointIndex], pointIndex
+                );
+            } else {
+                self->pendingEvaluations[evaluationAmount++] = pointIndex;
+            }
+        }
+        _optimizer_evaluate(self, self->pendingEvaluations, evaluationAmount);
+        _optimizer_cacheEvaluations(
+            self, self->pendingEvaluations, evaluationAmount
+        );
+        DEBUG_PRINT(
+            "evaluations: %ld of %ld\n",
+            evaluationAmount, self->possibleConnectionAmount
+        );
+    } else {
+        _optimizer_evaluate(
+            self, self->possibleConnections, self->possibleConnectionAmount
+        );
+    }
+    _optimizer_reduceCandidates(self, &best);
+
+    self->bestPointIndex = (
+        best.pointIndex != OPTIMIZER_NO_POINT
+        ? best.pointIndex
+        : self->possibleConnections[0]
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_evaluateLazily(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    const Indexer *indexer = &(self->sharedData->inputData.header->indexer);
+    const uint64_t startIndex = self->lastBestPointIndices[self->currentThreadIndex];
+    const uint64_t cacheOffset = (
+        self->currentThreadIndex * indexer_pairAmount(indexer)
+    );
+
+    OptimizerCandidateResult best = {
+        .error = 0,
+        .pointIndex = OPTIMIZER_NO_POINT
+    };
+
+    // Exact cached deltas are fresh. The stale ones are only used as
+    // estimates: the alpha mixed squared error with its wrapping uint8
+    // difference is not submodular, so a stale delta is no lower bound and
+    // lazy mode can commit a line that is not the argmin. It is an
+    // approximation of the exhaustive evaluation and may differ from it.
+    candidateQueue_clear(self->candidateQueue);
+    for (uint64_t i = 0; i < self->possibleConnectionAmount; ++i) {
+        const uint64_t pointIndex = self->possibleConnections[i];
+        const uint64_t cacheIndex = (
+            cacheOffset + indexer_pairIndex(indexer, startIndex, pointIndex)
+        );
+        const int64_t errorDelta = self->cachedErrorDeltas[cacheIndex];
+        if (!self->cachedErrorDeltaIsExact[cacheIndex]) {
+            candidateQueue_push(self->candidateQueue, errorDelta, pointIndex);
+        } else {
+            _optimizer_offerCandidate(
+                &best, self->lastBestError + (uint64_t)errorDelta, pointIndex
+            );
+        }
+    }
+
+    uint64_t evaluationAmount = 0;
+    while (!candidateQueue_isEmpty(self->candidateQueue)) {
+        // stop as soon as the best fresh delta beats every remaining
+        // estimate, which is a heuristic and not a proof of optimality
+        uint64_t batchAmount = 0;
+        while (
+            batchAmount < OPTIMIZER_LAZY_BATCH_SIZE
+            && !candidateQueue_isEmpty(self->candidateQueue)
+            && !(
+                best.pointIndex != OPTIMIZER_NO_POINT
+                && (int64_t)(best.error - self->lastBestError)
+                <= candidateQueue_peek(self->candidateQueue)->errorDelta
+            )
+        ) {
+            self->pendingEvaluations[batchAmount++] = (
+                candidateQueue_pop(self->candidateQueue).pointIndex
+            );
+        }
+        if (batchAmount == 0) {
+            break;
+        }
+
+        _optimizer_evaluate(self, self->pendingEvaluations, batchAmount);
+        _optimizer_cacheEvaluations(self, self->pendingEvaluations, batchAmount);
+        evaluationAmount += batchAmount;
+        _optimizer_reduceCandidates(self, &best);
+    }
+    DEBUG_PRINT(
+        "lazy evaluations: %ld of %ld\n",
+        evaluationAmount, self->possibleConnectionAmount
+    );
+
+    if (best.pointIndex != OPTIMIZER_NO_POINT) {
+        self->errors[best.pointIndex] = best.error;
+        self->bestPointIndex = best.pointIndex;
+    } else {
+        self->bestPointIndex = self->possibleConnections[0];
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+typedef struct {
+    const BeamState *state;
+    PixelOverlay *overlay;
+    const OptimizerReplica *replica;
+    uint64_t threadIndex;
+    int64_t errorDelta;
+} BeamLineContext;
+
+void _optimizer_beamPixel(
+    Optimizer *self,
+    void *context,
+    uint64_t imageIndex,
+    uint8_t coverage
+) {
+    DEBUG_ENTER_FUNC();
+    BeamLineContext *beamLineContext = (BeamLineContext*)context;
+    // pixels the path did not touch yet are read from the committed image
+    const PixelChange *change = pixelOverlay_find(
+        beamLineContext->state->overlay, imageIndex
+    );
+    Color oldColor = COLOR_NULL;
+    if (change) {
+        oldColor = change->color;
+    } else {
+        planarImage_get(self->lastBestImage, imageIndex, &oldColor);
+    }
+    const uint64_t oldError = (
+        change ? change->error : self->lastBestErrorImage[imageIndex]
+    );
+
+    Color newColor = COLOR_NULL;
+    const uint64_t newError = _optimizer_mixPixel(
+        self, beamLineContext->replica, beamLineContext->threadIndex,
+        imageIndex, &oldColor, coverage, &newColor
+    );
+    beamLineContext->errorDelta += (int64_t)newError - (int64_t)oldError;
+    if (beamLineContext->overlay) {
+        pixelOverlay_set(
+            beamLineContext->overlay, imageIndex, &newColor, newError
+        );
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_expandBeamTask(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer *const)argument;
+    const uint64_t threadIndex = self->beamThreadIndex;
+    while (true) {
+        const uint64_t begin = atomic_fetch_add_explicit(
+            &(self->candidateCursor),
+            self->tuning.chunkSize,
+            memory_order_relaxed
+        );
+        if (begin >= self->beamCandidateAmount) {
+            break;
+        }
+        uint64_t end = begin + self->tuning.chunkSize;
+        if (end > self->beamCandidateAmount) {
+            end = self->beamCandidateAmount;
+        }
+        for (uint64_t i = begin; i < end; ++i) {
+            BeamCandidate *candidate = &(self->beamCandidates[i]);
+            const BeamState *state = &(self->beamParents[candidate->stateIndex]);
+            BeamLineContext context = {
+                .state = state,
+                .overlay = NULL,
+                .replica = _optimizer_replica(self, workerIndex),
+                .threadIndex = threadIndex,
+                .errorDelta = 0
+            };
+            _optimizer_visitLine(
+                self, workerIndex, threadIndex,
+                state->lastPointIndices[threadIndex], candidate->pointIndex,
+                _optimizer_beamPixel, (void*)&context
+            );
+            candidate->error = state->error + (uint64_t)context.errorDelta;
+        }
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_buildBeamTask(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer *const)argument;
+    const uint64_t threadIndex = self->beamThreadIndex;
+    const uint64_t threadAmount = (
+        self->sharedData->inputData.header->indexer.threadAmount
+    );
+    while (true) {
+        const uint64_t i = atomic_fetch_add_explicit(
+            &(self->candidateCursor), 1, memory_order_relaxed
+        );
+        if (i >= self->beamChildAmount) {
+            break;
+        }
+        const BeamCandidate *candidate = &(self->beamCandidates[i]);
+        const BeamState *parent = &(self->beamParents[candidate->stateIndex]);
+        BeamState *child = &(self->beamChildren[i]);
+        const uint64_t startIndex = parent->lastPointIndices[threadIndex];
+
+        pixelOverlay_copy(child->overlay, parent->overlay);
+        BeamLineContext context = {
+            .state = parent,
+            .overlay = child->overlay,
+            .replica = _optimizer_replica(self, workerIndex),
+            .threadIndex = threadIndex,
+            .errorDelta = 0
+        };
+        _optimizer_visitLine(
+            self, workerIndex, threadIndex,
+            startIndex, candidate->pointIndex,
+            _optimizer_beamPixel, (void*)&context
+        );
+
+        memcpy(
+            (void*)child->lastPointIndices,
+            (const void*)parent->lastPointIndices,
+            threadAmount * sizeof(uint64_t)
+        );
+        child->lastPointIndices[threadIndex] = candidate->pointIndex;
+        memcpy(
+            (void*)child->moves,
+            (const void*)parent->moves,
+            parent->moveAmount * sizeof(Instruction)
+        );
+        child->moves[parent->moveAmount] = (Instruction){
+            .startIndex = startIndex,
+            .endIndex = candidate->pointIndex,
+            .threadIndex = threadIndex
+        };
+        child->moveAmount = parent->moveAmount + 1;
+        child->error = candidate->error;
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+int _optimizer_compareBeamCandidates(const void *a, const void *b) {
+    DEBUG_ENTER_FUNC();
+    const BeamCandidate *candidate1 = (const BeamCandidate*)a;
+    const BeamCandidate *candidate2 = (const BeamCandidate*)b;
+    int result = 0;
+    if (candidate1->error != candidate2->error) {
+        result = candidate1->error < candidate2->error ? -1 : 1;
+    } else if (candidate1->stateIndex != candidate2->stateIndex) {
+        result = candidate1->stateIndex < candidate2->stateIndex ? -1 : 1;
+    } else if (candidate1->pointIndex != candidate2->pointIndex) {
+        result = candidate1->pointIndex < candidate2->pointIndex ? -1 : 1;
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+bool _optimizer_beamStateUsesConnection(
+    const BeamState *state,
+    uint64_t startIndex,
+    uint64_t endIndex
+) {
+    DEBUG_ENTER_FUNC();
+    for (uint64_t i = 0; i < state->moveAmount; ++i) {
+        const Instruction *move = &(state->moves[i]);
+        if (
+            (move->startIndex == startIndex && move->endIndex == endIndex)
+            || (move->startIndex == endIndex && move->endIndex == startIndex)
+        ) {
+            DEBUG_EXIT_FUNC();
+            return true;
+        }
+    }
+    DEBUG_EXIT_FUNC();
+    return false;
+}
+
+void _optimizer_listBeamCandidates(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    const InputHeader *header = self->sharedData->inputData.header;
+    const bool skipDoneConnections = (
+        header->termination.flags & TERMINATE_ON_UNAVAILABLE_CONNECTION
+    );
+    self->beamCandidateAmount = 0;
+    for (uint64_t s = 0; s < self->beamParentAmount; ++s) {
+        const BeamState *state = &(self->beamParents[s]);
+        const uint64_t startIndex = state->lastPointIndices[self->beamThreadIndex];
+        uint64_t partnerAmount = 0;
+        if (skipDoneConnections) {
+            partnerAmount = connectionMatrix_availablePartners(
+                self->connectionMatrix, startIndex, self->beamPartners
+            );
+        } else {
+            for (uint64_t i = 0; i < header->indexer.pointAmount; ++i) {
+                if (i != startIndex) {
+                    self->beamPartners[partnerAmount++] = i;
+                }
+            }
+        }
+        for (uint64_t i = 0; i < partnerAmount; ++i) {
+            const uint64_t pointIndex = self->beamPartners[i];
+            if (
+                skipDoneConnections
+                && _optimizer_beamStateUsesConnection(state, startIndex, pointIndex)
+            ) {
                 continue;
             }
-            self->possibleConnections[j++] = i;
-            ++(self->possibleConnectionAmount);
+            self->beamCandidates[self->beamCandidateAmount++] = (BeamCandidate){
+                .stateIndex = s,
+                .pointIndex = pointIndex,
+                .error = 0
+            };
         }
     }
     DEBUG_EXIT_FUNC();
 }
 
+void _optimizer_searchBeam(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    const InputHeader *header = self->sharedData->inputData.header;
+    BeamState *root = &(self->beamStates[2 * self->beamWidth]);
+    pixelOverlay_clear(root->overlay);
+    memcpy(
+        (void*)root->lastPointIndices,
+        (const void*)self->lastBestPointIndices,
+        header->indexer.threadAmount * sizeof(uint64_t)
+    );
+    root->moveAmount = 0;
+    root->error = self->lastBestError;
+    self->beamParents = root;
+    self->beamParentAmount = 1;
+
+    uint64_t depth = self->beamDepth;
+    if (depth > header->termination.maxIterations - self->currentIteration) {
+        depth = header->termination.maxIterations - self->currentIteration;
+    }
+
+    // only the first line of the best path is committed, the search is
+    // repeated from the new image in the next iteration
+    uint64_t bestPointIndex = self->possibleConnections[0];
+    for (uint64_t level = 0; level < depth; ++level) {
+        self->beamThreadIndex = self->sharedData->inputData.threadOrder[
+            (self->currentIteration + level) % header->threadOrderSize
+        ];
+        _optimizer_listBeamCandidates(self);
+        if (self->beamCandidateAmount == 0) {
+            break;
+        }
+        _optimizer_runTask(
+            self, _optimizer_expandBeamTask, self->beamCandidateAmount
+        );
+        qsort(
+            (void*)self->beamCandidates,
+            self->beamCandidateAmount,
+            sizeof(BeamCandidate),
+            _optimizer_compareBeamCandidates
+        );
+
+        const BeamCandidate *best = &(self->beamCandidates[0]);
+        const BeamState *bestParent = &(self->beamParents[best->stateIndex]);
+        bestPointIndex = (
+            bestParent->moveAmount
+            ? bestParent->moves[0].endIndex
+            : best->pointIndex
+        );
+        if (level + 1 == depth) {
+            break;
+        }
+
+        self->beamChildAmount = (
+            self->beamCandidateAmount < self->beamWidth
+            ? self->beamCandidateAmount
+            : self->beamWidth
+        );
+        self->beamChildren = (
+            self->beamParents == self->beamStates
+            ? self->beamStates + self->beamWidth
+            : self->beamStates
+        );
+        _optimizer_runTask(
+            self, _optimizer_buildBeamTask, self->beamChildAmount
+        );
+        self->beamParents = self->beamChildren;
+        self->beamParentAmount = self->beamChildAmount;
+    }
+    self->bestPointIndex = bestPointIndex;
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_findBestConnection(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    if (self->beamStates) {
+        _optimizer_searchBeam(self);
+    } else if (self->candidateQueue) {
+        _optimizer_evaluateLazily(self);
+    } else {
+        _optimizer_evaluateExhaustively(self);
+    }
+    DEBUG_EXIT_FUNC();
+}
+
 void _optimizer_handleIterationResults(Optimizer *self) {
     DEBUG_ENTER_FUNC();
     const uint64_t imageWidth = self->sharedData->inputData.header->imageWidth;
     const uint64_t imageSize = imageWidth * imageWidth;
-    uint64_t bestPointIndex = 0;
-    uint64_t bestError = self->errors[0];
-    for (uint64_t i = 1; i < self->sharedData->inputData.header->indexer.pointAmount; ++i) {
-        if (self->errors[i] < bestError) {
-            bestError = self->errors[i];
-            bestPointIndex = i;
-        }
+    const uint64_t bestPointIndex = self->bestPointIndex;
+    if (!self->pixelDeltaIsCurrent[bestPointIndex]) {
+        // the winner's error came from the cache, its pixels are needed now
+        _optimizer_evaluate(self, &(self->bestPointIndex), 1);
     }
+    const uint64_t bestError = self->errors[bestPointIndex];
     self->sharedData->outputData.instructions[self->currentIteration] = (Instruction){
         .startIndex = self->lastBestPointIndices[self->currentThreadIndex],
         .endIndex = bestPointIndex,
         .threadIndex = self->currentThreadIndex
     };
+    const uint64_t startIndex = self->lastBestPointIndices[self->currentThreadIndex];
+    connectionMatrix_markDone(self->connectionMatrix, startIndex, bestPointIndex);
     self->lastBestPointIndices[self->currentThreadIndex] = bestPointIndex;
-    memcpy(
-        (void*)self->lastBestImage,
-        (void*)self->imageBuffer + imageSize * bestPointIndex,
-        imageSize * sizeof(Color)
-    );
-    memcpy(
-        (void*)self->lastBestErrorImage,
-        (void*)self->errorBuffer + imageSize * bestPointIndex,
-        imageSize * sizeof(uint64_t)
+    self->lineKernels->commitLine(
+        self->pixelDeltas[bestPointIndex],
+        self->lastBestImage,
+        self->lastBestErrorImage
     );
+    if (self->spatialIndex) {
+        spatialIndex_invalidate(
+            self->spatialIndex,
+            self->pixelDeltas[bestPointIndex],
+            self->cachedErrorDeltaIsExact,
+            self->sharedData->inputData.header->indexer.threadAmount
+        );
+    } else if (self->cachedErrorDeltaIsExact) {
+        memset(
+            (void*)self->cachedErrorDeltaIsExact,
+            0,
+            self->sharedData->inputData.header->indexer.threadAmount
+            * indexer_pairAmount(&(self->sharedData->inputData.header->indexer))
+            * sizeof(bool)
+        );
+    }
     self->lastBestError = bestError;
     self->lastNormalizedError = self->currentNormalizedError;
     self->currentNormalizedError = bestError / imageSize;
@@ -477,10 +1846,13 @@ bool _optimizer_postCheckTermination(Optimizer *self) {
     return false;
 }
 
-uint64_t _optimizer_mainloop(Optimizer *self) {
+uint64_t _optimizer_mainloop(Optimizer *self, uint64_t firstIteration) {
     DEBUG_ENTER_FUNC();
+    // tuning starts only here, so the replayed iterations of the pyramid
+    // do not count
+    _optimizer_startTuning(self);
     for (
-        self->currentIteration = 0;
+        self->currentIteration = firstIteration;
         self->currentIteration < self->sharedData->inputData.header->termination.maxIterations;
         ++(self->currentIteration)
     ) {
@@ -491,18 +1863,23 @@ uint64_t _optimizer_mainloop(Optimizer *self) {
             DEBUG_EXIT_FUNC();
             return result;
         }
-        workerPool_runTask(self->workerPool);
+        _optimizer_findBestConnection(self);
         _optimizer_handleIterationResults(self);
+        _optimizer_tune(self);
         if (self->sharedData->inputData.header->debugFlags) {
             _optimizer_storeDebugInformation(self);
         }
 
+#if defined(DEBUG) && defined(IMAGES)
+        // the result buffer is overwritten by the final image anyway
         char buffer[128];
         snprintf(buffer, sizeof(buffer), "images/lastBestImage_%ld.jpg", self->currentIteration);
+        planarImage_pack(self->lastBestImage, self->sharedData->outputData.result);
         DEBUG_SAVE_IMAGE(
             buffer,
-            self->lastBestImage
+            self->sharedData->outputData.result
         );
+#endif // DEBUG && IMAGES
 
         if (_optimizer_postCheckTermination(self)) {
             uint64_t result = self->currentIteration + 1;
@@ -515,28 +1892,132 @@ uint64_t _optimizer_mainloop(Optimizer *self) {
     return result;
 }
 
+void _optimizer_packResultRange(
+    void *argument,
+    size_t begin,
+    size_t end,
+    size_t workerIndex
+) {
+    DEBUG_ENTER_FUNC();
+    Optimizer *self = (Optimizer*)argument;
+    planarImage_packRange(
+        self->lastBestImage, self->sharedData->outputData.result, begin, end
+    );
+    DEBUG_EXIT_FUNC();
+}
+
 void _optimizer_writeOutputData(Optimizer *self, uint64_t iterationAmount) {
     DEBUG_ENTER_FUNC();
     const uint64_t imageWidth = self->sharedData->inputData.header->imageWidth;
     const uint64_t imageSize = imageWidth * imageWidth;
     self->sharedData->outputData.header->instructionAmount = iterationAmount;
-    self->sharedData->outputData.header->absoluteError = self->lastBestError;
-    self->sharedData->outputData.header->normalizedError = self->currentNormalizedError;
-    memcpy(
-        (void*)self->sharedData->outputData.result,
-        (void*)self->lastBestImage,
-        imageSize
+    const uint64_t absoluteError = (uint64_t)llround(
+        (double)(self->lastBestError)
+        * self->sharedData->inputData.header->importanceFormat.scale
+    );
+    self->sharedData->outputData.header->absoluteError = absoluteError;
+    self->sharedData->outputData.header->normalizedError = absoluteError / imageSize;
+    // the best fields may be mid-search after a drift, so the output
+    // reports what the last iteration really ran with
+    self->sharedData->outputData.header->workerAmount = (
+        self->tuning.ranWorkerAmount
+    );
+    self->sharedData->outputData.header->candidateChunkSize = (
+        self->tuning.ranChunkSize
+    );
+    workerPool_parallelFor(
+        self->workerPool, 0, imageSize,
+        OPTIMIZER_PIXEL_CHUNK_SIZE, _optimizer_packResultRange, (void*)self
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+void _optimizer_replay(
+    Optimizer *self,
+    const Instruction *instructions,
+    uint64_t instructionAmount
+) {
+    DEBUG_ENTER_FUNC();
+    for (
+        self->currentIteration = 0;
+        self->currentIteration < instructionAmount;
+        ++(self->currentIteration)
+    ) {
+        _optimizer_prepareIteration(self);
+        const Instruction *instruction = &(instructions[self->currentIteration]);
+        DEBUG_ASSERT(
+            instruction->threadIndex == self->currentThreadIndex
+            && instruction->startIndex == self->lastBestPointIndices[self->currentThreadIndex],
+            "replayed instructions have to follow the thread order."
+        );
+        self->bestPointIndex = instruction->endIndex;
+        _optimizer_handleIterationResults(self);
+        if (self->sharedData->inputData.header->debugFlags) {
+            _optimizer_storeDebugInformation(self);
+        }
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+uint64_t _optimizer_optimizeCoarsely(Optimizer *self) {
+    DEBUG_ENTER_FUNC();
+    const InputHeader *header = self->sharedData->inputData.header;
+    const Pyramid *pyramid = &(header->pyramid);
+    if (pyramid->downscaleFactor <= 1 || pyramid->coarseIterationRatio <= 0.0) {
+        DEBUG_EXIT_FUNC();
+        return 0;
+    }
+    uint64_t maxIterations = (uint64_t)(
+        pyramid->coarseIterationRatio
+        * (double)(header->termination.maxIterations)
+    );
+    if (maxIterations > header->termination.maxIterations) {
+        maxIterations = header->termination.maxIterations;
+    }
+    if (maxIterations == 0 || header->imageWidth / pyramid->downscaleFactor < 2) {
+        DEBUG_EXIT_FUNC();
+        return 0;
+    }
+
+    SharedData coarseSharedData;
+    if (!sharedData_downsample(
+        &coarseSharedData, self->sharedData,
+        pyramid->downscaleFactor, maxIterations
+    )) {
+        PRINT_ERROR("error while downsampling, optimizing at full resolution instead");
+        DEBUG_EXIT_FUNC();
+        return 0;
+    }
+
+    Optimizer *coarseOptimizer = _optimizer_new(&coarseSharedData, self);
+    if (!coarseOptimizer) {
+        PRINT_ERROR("error while constructing coarse optimizer, optimizing at full resolution instead");
+        sharedData_free(&coarseSharedData);
+        DEBUG_EXIT_FUNC();
+        return 0;
+    }
+    optimizer_optimize(coarseOptimizer);
+    optimizer_delete(coarseOptimizer);
+
+    // the coarse strings are redrawn at full resolution, which yields the
+    // exact full resolution image and error to continue from
+    const uint64_t instructionAmount = (
+        coarseSharedData.outputData.header->instructionAmount
     );
+    DEBUG_PRINT("coarse instructionAmount: %ld\n", instructionAmount);
+    _optimizer_replay(
+        self, coarseSharedData.outputData.instructions, instructionAmount
+    );
+    sharedData_free(&coarseSharedData);
+
     DEBUG_EXIT_FUNC();
+    return instructionAmount;
 }
 
 void optimizer_optimize(Optimizer *self) {
     DEBUG_ENTER_FUNC();
-    workerPool_start(self->workerPool);
-    workerPool_setTask(self->workerPool, _optimizer_optimizeTask);
-    workerPool_setArgument(self->workerPool, (void*)self);
-    uint64_t iterationAmount = _optimizer_mainloop(self);
-    workerPool_stop(self->workerPool);
+    const uint64_t firstIteration = _optimizer_optimizeCoarsely(self);
+    uint64_t iterationAmount = _optimizer_mainloop(self, firstIteration);
     _optimizer_writeOutputData(self, iterationAmount);
     DEBUG_EXIT_FUNC();
 }
@@ -4,28 +4,191 @@
 #include "shared_data.h"
 #include "worker_pool.h"
 #include "line_renderer.h"
+#include "pixel_delta.h"
+#include "line_atlas.h"
+#include "candidate_queue.h"
+#include "spatial_index.h"
+#include "connection_matrix.h"
+#include "pixel_overlay.h"
+#include "planar_image.h"
+#include "line_kernels.h"
+#include "pin_table.h"
+#include "numa_memory.h"
 
 #include <stdbool.h>
+#include <stdatomic.h>
 
+// one chunk of candidates is rasterized as one fan
+#ifndef OPTIMIZER_CANDIDATE_CHUNK_SIZE
+#define OPTIMIZER_CANDIDATE_CHUNK_SIZE (LINE_RENDERER_FAN_SIZE)
+#endif // OPTIMIZER_CANDIDATE_CHUNK_SIZE
+
+// bounds of the candidate chunk sizes the tuning tries
+#ifndef OPTIMIZER_MIN_CANDIDATE_CHUNK_SIZE
+#define OPTIMIZER_MIN_CANDIDATE_CHUNK_SIZE (LINE_RENDERER_FAN_SIZE / 2)
+#endif // OPTIMIZER_MIN_CANDIDATE_CHUNK_SIZE
+
+#ifndef OPTIMIZER_MAX_CANDIDATE_CHUNK_SIZE
+#define OPTIMIZER_MAX_CANDIDATE_CHUNK_SIZE (LINE_RENDERER_FAN_SIZE * 4)
+#endif // OPTIMIZER_MAX_CANDIDATE_CHUNK_SIZE
+
+// iterations timed per configuration while tuning
+#ifndef OPTIMIZER_TUNING_ITERATIONS
+#define OPTIMIZER_TUNING_ITERATIONS (4)
+#endif // OPTIMIZER_TUNING_ITERATIONS
+
+// iterations between two checks of the locked configuration
+#ifndef OPTIMIZER_TUNING_INTERVAL
+#define OPTIMIZER_TUNING_INTERVAL (64)
+#endif // OPTIMIZER_TUNING_INTERVAL
+
+// factor the time per candidate may drift by before tuning again
+#ifndef OPTIMIZER_TUNING_DRIFT
+#define OPTIMIZER_TUNING_DRIFT (1.5)
+#endif // OPTIMIZER_TUNING_DRIFT
+
+#define OPTIMIZER_TUNING_WORKERS (0)
+#define OPTIMIZER_TUNING_CHUNKS (1)
+#define OPTIMIZER_TUNING_LOCKED (2)
+
+// candidates re-evaluated per round in lazy greedy mode; fixed so that the
+// result does not depend on the worker amount
+#ifndef OPTIMIZER_LAZY_BATCH_SIZE
+#define OPTIMIZER_LAZY_BATCH_SIZE (16)
+#endif // OPTIMIZER_LAZY_BATCH_SIZE
+
+// pixels per chunk of the parallel image passes
+#ifndef OPTIMIZER_PIXEL_CHUNK_SIZE
+#define OPTIMIZER_PIXEL_CHUNK_SIZE (16384)
+#endif // OPTIMIZER_PIXEL_CHUNK_SIZE
+
+// marks a candidate result without a candidate
+#define OPTIMIZER_NO_POINT (UINT64_MAX)
+
+// Candidates are ordered by error, equal errors by pin index.
+typedef struct {
+    uint64_t error;
+    uint64_t pointIndex;
+} OptimizerCandidateResult;
+
+// What one worker found in the last task. Every worker writes only its own
+// slot, which fills a whole cache line, so the slots of neighbouring workers
+// never share one.
 typedef struct {
+    OptimizerCandidateResult best;
+    uint64_t errorSum;
+    uint8_t padding[
+        WORKER_POOL_CACHE_LINE_SIZE
+        - sizeof(OptimizerCandidateResult)
+        - sizeof(uint64_t)
+    ];
+} OptimizerWorkerResult;
+
+// The read-only inputs of the candidate evaluation as seen from one memory
+// node. Replica 0 is the optimizer's own data; in NUMA mode every further
+// node of the workers gets copies in its own memory.
+typedef struct {
+    PlanarImage *target;
+    uint16_t *pixelWeights;
+    LineAtlas *lineAtlas;
+} OptimizerReplica;
+
+// The candidate evaluation is timed per candidate, first halving the
+// worker amount from all workers as long as that gets faster, then trying
+// the chunk sizes at the best worker amount. The best configuration is
+// kept until its time per candidate drifts. The ran fields hold the
+// configuration the last task actually ran with.
+typedef struct {
+    uint64_t phase;
+    size_t workerAmount;
+    uint64_t chunkSize;
+    size_t bestWorkerAmount;
+    uint64_t bestChunkSize;
+    size_t ranWorkerAmount;
+    uint64_t ranChunkSize;
+    double bestTime;
+    double lockedTime;
+    uint64_t iterationAmount;
+    double elapsed;
+    uint64_t workAmount;
+} OptimizerTuning;
+
+// A partial path of the beam search. Its image is the committed image with
+// the overlay on top, so states never clone the full image.
+typedef struct {
+    PixelOverlay *overlay;
+    uint64_t *lastPointIndices;
+    Instruction *moves;
+    uint64_t moveAmount;
+    uint64_t error;
+} BeamState;
+
+typedef struct {
+    uint64_t stateIndex;
+    uint64_t pointIndex;
+    uint64_t error;
+} BeamCandidate;
+
+typedef struct Optimizer {
     SharedData *sharedData;
+    // set on the coarse level of the pyramid, whose pool and task group
+    // are borrowed from the parent
+    struct Optimizer *parent;
     WorkerPool *workerPool;
+    WorkerPoolTaskGroup *taskGroup;
+    OptimizerWorkerResult *workerResults;
+    PinTable *pinTable;
     LineRenderer **lineRenderers;
+    LineAtlas *lineAtlas;
+    const LineKernels *lineKernels;
+    LineSpan *lineSpans;
+    uint32_t *linePixelIndices;
+    uint8_t *lineCoverages;
+    uint64_t linePixelCapacity;
 
-    Color *lastBestImage;
-    Color *imageBuffer;
+    PlanarImage *target;
+    PlanarImage *lastBestImage;
     uint64_t *lastBestErrorImage;
-    uint64_t *errorBuffer;
+    PixelDelta **pixelDeltas;
     uint64_t lastBestError;
     uint64_t *errors;
     uint64_t *lastBestPointIndices;
     uint64_t *possibleConnections;
-    bool **connectionIsDone;
+    ConnectionMatrix *connectionMatrix;
     double *thicknessesInPixels;
+    uint64_t *thicknessClasses;
+    uint16_t *pixelWeights;
+    uint32_t *mixWeights;
+    OptimizerReplica *replicas;
+    size_t replicaAmount;
 
     uint64_t currentThreadIndex;
     uint64_t currentIteration;
     uint64_t possibleConnectionAmount;
+    uint64_t *evaluations;
+    uint64_t evaluationAmount;
+    atomic_uint_fast64_t candidateCursor;
+    OptimizerTuning tuning;
+    uint64_t bestPointIndex;
+
+    bool *pixelDeltaIsCurrent;
+    CandidateQueue *candidateQueue;
+    SpatialIndex *spatialIndex;
+    uint64_t *pendingEvaluations;
+    int64_t *cachedErrorDeltas;
+    bool *cachedErrorDeltaIsExact;
+
+    uint64_t beamWidth;
+    uint64_t beamDepth;
+    BeamState *beamStates;
+    BeamState *beamParents;
+    BeamState *beamChildren;
+    uint64_t beamParentAmount;
+    uint64_t beamChildAmount;
+    BeamCandidate *beamCandidates;
+    uint64_t beamCandidateAmount;
+    uint64_t beamThreadIndex;
+    uint64_t *beamPartners;
 
     // uint64_t minError;
     // double minRelativeError;
@@ -0,0 +1,102 @@
+#include "pin_table.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+PinTable * pinTable_new(const InputData *inputData) {
+    DEBUG_ENTER_FUNC();
+    const InputHeader *header = inputData->header;
+    const uint64_t pointAmount = header->indexer.pointAmount;
+    const uint64_t imageWidth = header->imageWidth;
+
+    PinTable *pinTable = (PinTable*)calloc(1, sizeof(PinTable));
+    if (!pinTable) {
+        PRINT_ERROR("error while allocating pinTable");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    pinTable->pointAmount = pointAmount;
+    pinTable->isCircular = (header->pinLayout.kind == PIN_LAYOUT_CIRCLE);
+
+    pinTable->x = (double*)malloc(pointAmount * sizeof(double));
+    if (!pinTable->x) {
+        PRINT_ERROR("error while allocating pinTable->x");
+        goto ERROR;
+    }
+
+    pinTable->y = (double*)malloc(pointAmount * sizeof(double));
+    if (!pinTable->y) {
+        PRINT_ERROR("error while allocating pinTable->y");
+        goto ERROR;
+    }
+
+    for (uint64_t i = 0; i < pointAmount; ++i) {
+        if (pinTable->isCircular) {
+            indexer_pointPosition(
+                &(header->indexer), imageWidth, i,
+                &(pinTable->x[i]), &(pinTable->y[i])
+            );
+            continue;
+        }
+
+        // the packed layout gives no alignment guarantee
+        memcpy(
+            (void*)&(pinTable->x[i]),
+            (const void*)&(inputData->pinPositions[2 * i]),
+            sizeof(double)
+        );
+        memcpy(
+            (void*)&(pinTable->y[i]),
+            (const void*)&(inputData->pinPositions[2 * i + 1]),
+            sizeof(double)
+        );
+        if (
+            !(pinTable->x[i] >= 0.0 && pinTable->x[i] <= (double)imageWidth)
+            || !(pinTable->y[i] >= 0.0 && pinTable->y[i] <= (double)imageWidth)
+        ) {
+            char buffer[128];
+            snprintf(
+                buffer,
+                sizeof(buffer),
+                "pin %ld lies outside of the image",
+                i
+            );
+            PRINT_ERROR_WITH_NUMBER(buffer, EINVAL);
+            goto ERROR;
+        }
+    }
+
+    DEBUG_EXIT_FUNC();
+    return pinTable;
+
+ERROR:
+    pinTable_delete(pinTable);
+    DEBUG_EXIT_FUNC();
+    return NULL;
+}
+
+void pinTable_delete(PinTable *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->y);
+        free(self->x);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void pinTable_position(
+    const PinTable *self,
+    uint64_t pointIndex,
+    double *x,
+    double *y
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(pointIndex < self->pointAmount, "pin index out of range.");
+    *x = self->x[pointIndex];
+    *y = self->y[pointIndex];
+    DEBUG_EXIT_FUNC();
+}
@@ -0,0 +1,29 @@
+#ifndef __PIN_TABLE_H__
+#define __PIN_TABLE_H__
+
+#include "shared_data.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Sub-pixel position of every pin, computed once so line rasterization
+// never has to evaluate the pin layout again. Circular layouts keep the
+// disc as their canvas, custom layouts use the whole image.
+typedef struct {
+    uint64_t pointAmount;
+    bool isCircular;
+    double *x;
+    double *y;
+} PinTable;
+
+PinTable * pinTable_new(const InputData *inputData);
+void pinTable_delete(PinTable *self);
+
+void pinTable_position(
+    const PinTable *self,
+    uint64_t pointIndex,
+    double *x,
+    double *y
+);
+
+#endif // __PIN_TABLE_H__
@@ -0,0 +1,62 @@
+#include "pixel_delta.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+
+PixelDelta * pixelDelta_new(uint64_t capacity) {
+    DEBUG_ENTER_FUNC();
+    PixelDelta *pixelDelta = (PixelDelta*)calloc(1, sizeof(PixelDelta));
+    if (!pixelDelta) {
+        PRINT_ERROR("error while allocating pixelDelta");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    pixelDelta->imageIndices = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    if (!pixelDelta->imageIndices) {
+        PRINT_ERROR("error while allocating pixelDelta->imageIndices");
+        goto ERROR;
+    }
+
+    pixelDelta->errors = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    if (!pixelDelta->errors) {
+        PRINT_ERROR("error while allocating pixelDelta->errors");
+        goto ERROR;
+    }
+
+    pixelDelta->colors = planarImage_new(capacity);
+    if (!pixelDelta->colors) {
+        PRINT_ERROR("error while constructing pixelDelta->colors");
+        goto ERROR;
+    }
+
+    pixelDelta->changeAmount = 0;
+    pixelDelta->capacity = capacity;
+
+    DEBUG_EXIT_FUNC();
+    return pixelDelta;
+
+ERROR:
+    pixelDelta_delete(pixelDelta);
+    DEBUG_EXIT_FUNC();
+    return NULL;
+}
+
+void pixelDelta_delete(PixelDelta *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        planarImage_delete(self->colors);
+        free(self->errors);
+        free(self->imageIndices);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void pixelDelta_clear(PixelDelta *self) {
+    DEBUG_ENTER_FUNC();
+    self->changeAmount = 0;
+    DEBUG_EXIT_FUNC();
+}
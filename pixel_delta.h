@@ -0,0 +1,25 @@
+#ifndef __PIXEL_DELTA_H__
+#define __PIXEL_DELTA_H__
+
+#include "color.h"
+#include "planar_image.h"
+
+#include <stdint.h>
+
+// Pixels a candidate line would change, as parallel arrays: change i sets
+// pixel imageIndices[i] to the i-th color of colors and its error to
+// errors[i].
+typedef struct {
+    uint64_t *imageIndices;
+    uint64_t *errors;
+    PlanarImage *colors;
+    uint64_t changeAmount;
+    uint64_t capacity;
+} PixelDelta;
+
+PixelDelta * pixelDelta_new(uint64_t capacity);
+void pixelDelta_delete(PixelDelta *self);
+
+void pixelDelta_clear(PixelDelta *self);
+
+#endif // __PIXEL_DELTA_H__
@@ -0,0 +1,127 @@
+#include "pixel_overlay.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define EMPTY_SLOT (0xffffffffffffffff)
+#define HASH_MULTIPLIER (0x9e3779b97f4a7c15)
+
+PixelOverlay * pixelOverlay_new(uint64_t capacity) {
+    DEBUG_ENTER_FUNC();
+    PixelOverlay *pixelOverlay = (PixelOverlay*)malloc(sizeof(PixelOverlay));
+    if (!pixelOverlay) {
+        PRINT_ERROR("error while allocating pixelOverlay");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    // keep the load factor at or below one half
+    uint64_t slotAmount = 1;
+    while (slotAmount < 2 * capacity) {
+        slotAmount <<= 1;
+    }
+    pixelOverlay->slots = (PixelChange*)malloc(slotAmount * sizeof(PixelChange));
+    if (!pixelOverlay->slots) {
+        free(pixelOverlay);
+        PRINT_ERROR("error while allocating pixelOverlay->slots");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    pixelOverlay->slotMask = slotAmount - 1;
+    pixelOverlay->capacity = capacity;
+    pixelOverlay_clear(pixelOverlay);
+
+    DEBUG_EXIT_FUNC();
+    return pixelOverlay;
+}
+
+void pixelOverlay_delete(PixelOverlay *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->slots);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void pixelOverlay_clear(PixelOverlay *self) {
+    DEBUG_ENTER_FUNC();
+    for (uint64_t i = 0; i <= self->slotMask; ++i) {
+        self->slots[i].imageIndex = EMPTY_SLOT;
+    }
+    self->changeAmount = 0;
+    DEBUG_EXIT_FUNC();
+}
+
+void pixelOverlay_copy(PixelOverlay *self, const PixelOverlay *other) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(
+        self->slotMask == other->slotMask,
+        "pixelOverlays need the same size to be copied."
+    );
+    memcpy(
+        (void*)self->slots,
+        (const void*)other->slots,
+        (self->slotMask + 1) * sizeof(PixelChange)
+    );
+    self->changeAmount = other->changeAmount;
+    DEBUG_EXIT_FUNC();
+}
+
+uint64_t _pixelOverlay_slotIndex(
+    const PixelOverlay *self,
+    uint64_t imageIndex
+) {
+    DEBUG_ENTER_FUNC();
+    uint64_t slotIndex = ((imageIndex * HASH_MULTIPLIER) >> 32) & self->slotMask;
+    while (
+        self->slots[slotIndex].imageIndex != EMPTY_SLOT
+        && self->slots[slotIndex].imageIndex != imageIndex
+    ) {
+        slotIndex = (slotIndex + 1) & self->slotMask;
+    }
+    DEBUG_EXIT_FUNC();
+    return slotIndex;
+}
+
+void pixelOverlay_set(
+    PixelOverlay *self,
+    uint64_t imageIndex,
+    const Color *color,
+    uint64_t error
+) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t slotIndex = _pixelOverlay_slotIndex(self, imageIndex);
+    if (self->slots[slotIndex].imageIndex == EMPTY_SLOT) {
+        DEBUG_ASSERT(
+            self->changeAmount < self->capacity,
+            "pixelOverlay capacity exceeded."
+        );
+        ++(self->changeAmount);
+    }
+    self->slots[slotIndex] = (PixelChange){
+        .imageIndex = imageIndex,
+        .error = error,
+        .color = *color
+    };
+    DEBUG_EXIT_FUNC();
+}
+
+const PixelChange * pixelOverlay_find(
+    const PixelOverlay *self,
+    uint64_t imageIndex
+) {
+    DEBUG_ENTER_FUNC();
+    const uint64_t slotIndex = _pixelOverlay_slotIndex(self, imageIndex);
+    const PixelChange *result = (
+        self->slots[slotIndex].imageIndex == EMPTY_SLOT
+        ? NULL
+        : &(self->slots[slotIndex])
+    );
+    DEBUG_EXIT_FUNC();
+    return result;
+}
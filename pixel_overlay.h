@@ -0,0 +1,39 @@
+#ifndef __PIXEL_OVERLAY_H__
+#define __PIXEL_OVERLAY_H__
+
+#include "color.h"
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t imageIndex;
+    uint64_t error;
+    Color color;
+} PixelChange;
+
+// Sparse copy-on-write layer over a shared image: only pixels that were
+// changed are stored, in an open addressing hash table keyed by image index.
+typedef struct {
+    PixelChange *slots;
+    uint64_t slotMask;
+    uint64_t changeAmount;
+    uint64_t capacity;
+} PixelOverlay;
+
+PixelOverlay * pixelOverlay_new(uint64_t capacity);
+void pixelOverlay_delete(PixelOverlay *self);
+
+void pixelOverlay_clear(PixelOverlay *self);
+void pixelOverlay_copy(PixelOverlay *self, const PixelOverlay *other);
+void pixelOverlay_set(
+    PixelOverlay *self,
+    uint64_t imageIndex,
+    const Color *color,
+    uint64_t error
+);
+const PixelChange * pixelOverlay_find(
+    const PixelOverlay *self,
+    uint64_t imageIndex
+);
+
+#endif // __PIXEL_OVERLAY_H__
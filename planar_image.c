@@ -0,0 +1,108 @@
+#include "planar_image.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+PlanarImage * planarImage_new(uint64_t pixelAmount) {
+    DEBUG_ENTER_FUNC();
+    PlanarImage *planarImage = (PlanarImage*)malloc(sizeof(PlanarImage));
+    if (!planarImage) {
+        PRINT_ERROR("error while allocating planarImage");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    // padding every plane to the alignment keeps the next one aligned and
+    // lets vector loops run over whole blocks
+    planarImage->pixelAmount = pixelAmount;
+    planarImage->planeSize = (
+        (pixelAmount + PLANAR_IMAGE_ALIGNMENT - 1)
+        / PLANAR_IMAGE_ALIGNMENT * PLANAR_IMAGE_ALIGNMENT
+    );
+    if (planarImage->planeSize == 0) {
+        planarImage->planeSize = PLANAR_IMAGE_ALIGNMENT;
+    }
+    planarImage->c = (uint8_t*)aligned_alloc(
+        PLANAR_IMAGE_ALIGNMENT, 3 * planarImage->planeSize
+    );
+    if (!planarImage->c) {
+        free(planarImage);
+        PRINT_ERROR("error while allocating planarImage->c");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    memset((void*)planarImage->c, 0, 3 * planarImage->planeSize);
+    planarImage->m = planarImage->c + planarImage->planeSize;
+    planarImage->y = planarImage->m + planarImage->planeSize;
+
+    DEBUG_EXIT_FUNC();
+    return planarImage;
+}
+
+void planarImage_delete(PlanarImage *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->c);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void planarImage_get(const PlanarImage *self, uint64_t index, Color *color) {
+    DEBUG_ENTER_FUNC();
+    color->c = self->c[index];
+    color->m = self->m[index];
+    color->y = self->y[index];
+    DEBUG_EXIT_FUNC();
+}
+
+void planarImage_set(PlanarImage *self, uint64_t index, const Color *color) {
+    DEBUG_ENTER_FUNC();
+    self->c[index] = color->c;
+    self->m[index] = color->m;
+    self->y[index] = color->y;
+    DEBUG_EXIT_FUNC();
+}
+
+void planarImage_unpack(PlanarImage *self, const Color *colors) {
+    DEBUG_ENTER_FUNC();
+    planarImage_unpackRange(self, colors, 0, self->pixelAmount);
+    DEBUG_EXIT_FUNC();
+}
+
+void planarImage_pack(const PlanarImage *self, Color *colors) {
+    DEBUG_ENTER_FUNC();
+    planarImage_packRange(self, colors, 0, self->pixelAmount);
+    DEBUG_EXIT_FUNC();
+}
+
+void planarImage_unpackRange(
+    PlanarImage *self,
+    const Color *colors,
+    uint64_t begin,
+    uint64_t end
+) {
+    DEBUG_ENTER_FUNC();
+    for (uint64_t i = begin; i < end; ++i) {
+        self->c[i] = colors[i].c;
+        self->m[i] = colors[i].m;
+        self->y[i] = colors[i].y;
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void planarImage_packRange(
+    const PlanarImage *self,
+    Color *colors,
+    uint64_t begin,
+    uint64_t end
+) {
+    DEBUG_ENTER_FUNC();
+    for (uint64_t i = begin; i < end; ++i) {
+        colors[i] = (Color){ self->c[i], self->m[i], self->y[i] };
+    }
+    DEBUG_EXIT_FUNC();
+}
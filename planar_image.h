@@ -0,0 +1,46 @@
+#ifndef __PLANAR_IMAGE_H__
+#define __PLANAR_IMAGE_H__
+
+#include "color.h"
+
+#include <stdint.h>
+
+#ifndef PLANAR_IMAGE_ALIGNMENT
+#define PLANAR_IMAGE_ALIGNMENT (64)
+#endif // PLANAR_IMAGE_ALIGNMENT
+
+// Color image stored as separate C, M and Y planes of one byte per pixel.
+// Every plane starts on its own PLANAR_IMAGE_ALIGNMENT boundary, so runs of
+// pixels can be loaded as vectors, unlike the packed 3 byte Color records
+// that are only used at the SharedData boundary.
+typedef struct {
+    uint64_t pixelAmount;
+    uint64_t planeSize;
+    uint8_t *c;
+    uint8_t *m;
+    uint8_t *y;
+} PlanarImage;
+
+PlanarImage * planarImage_new(uint64_t pixelAmount);
+void planarImage_delete(PlanarImage *self);
+
+void planarImage_get(const PlanarImage *self, uint64_t index, Color *color);
+void planarImage_set(PlanarImage *self, uint64_t index, const Color *color);
+void planarImage_unpack(PlanarImage *self, const Color *colors);
+void planarImage_pack(const PlanarImage *self, Color *colors);
+// the same for the pixels begin .. end - 1 only, so that disjoint ranges
+// can be converted in parallel
+void planarImage_unpackRange(
+    PlanarImage *self,
+    const Color *colors,
+    uint64_t begin,
+    uint64_t end
+);
+void planarImage_packRange(
+    const PlanarImage *self,
+    Color *colors,
+    uint64_t begin,
+    uint64_t end
+);
+
+#endif // __PLANAR_IMAGE_H__
@@ -4,8 +4,78 @@
 #include "debug.h"
 
 #include <sys/shm.h>
+#include <string.h>
+#include <math.h>
 
 #define SHARED_MEMORY_ACCESS_MODE (0666)
+#define TWO_PI (2.0 * 3.14159265358979323846264338328)
+
+uint64_t indexer_pairAmount(const Indexer *self) {
+    DEBUG_ENTER_FUNC();
+    uint64_t result = self->pointAmount * (self->pointAmount - 1) / 2;
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+uint64_t indexer_pairIndex(
+    const Indexer *self,
+    uint64_t pointIndex1,
+    uint64_t pointIndex2
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(pointIndex1 != pointIndex2, "a pair needs two different points.");
+    const uint64_t i = (pointIndex1 < pointIndex2) ? pointIndex1 : pointIndex2;
+    const uint64_t j = (pointIndex1 < pointIndex2) ? pointIndex2 : pointIndex1;
+    // row-major index into the strict upper triangle
+    uint64_t result = i * (2 * self->pointAmount - i - 1) / 2 + (j - i - 1);
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+void indexer_pointPosition(
+    const Indexer *self,
+    uint64_t imageWidth,
+    uint64_t pointIndex,
+    double *x,
+    double *y
+) {
+    DEBUG_ENTER_FUNC();
+    const double angle = (
+        TWO_PI * (double)pointIndex / (double)(self->pointAmount)
+    );
+    const double imageRadius = (double)imageWidth / 2.0;
+    *x = cos(angle) * imageRadius + imageRadius;
+    *y = (double)imageWidth - (sin(angle) * imageRadius + imageRadius);
+    DEBUG_EXIT_FUNC();
+}
+
+uint64_t inputData_pinPositionAmount(const InputData *self) {
+    DEBUG_ENTER_FUNC();
+    // x and y of every pin, only custom layouts carry positions
+    uint64_t result = 0;
+    if (self->header->pinLayout.kind == PIN_LAYOUT_CUSTOM) {
+        result = 2 * self->header->indexer.pointAmount;
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+uint16_t inputData_importanceWeight(const InputData *self, uint64_t index) {
+    DEBUG_ENTER_FUNC();
+    uint16_t result = 0;
+    if (self->header->importanceFormat.bytesPerWeight == sizeof(uint16_t)) {
+        // the packed layout gives no alignment guarantee
+        memcpy(
+            (void*)&result,
+            (const uint8_t*)(self->importance) + index * sizeof(uint16_t),
+            sizeof(uint16_t)
+        );
+    } else {
+        result = ((const uint8_t*)(self->importance))[index];
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
 
 uint8_t * _input_data_initialize(InputData *data, uint8_t *memory) {
     DEBUG_ENTER_FUNC();
@@ -21,13 +91,16 @@ uint8_t * _input_data_initialize(InputData *data, uint8_t *memory) {
     data->startPoints = (uint64_t*)memory;
     memory += sizeof(uint64_t) * data->header->indexer.threadAmount;
 
+    data->pinPositions = (double*)memory;
+    memory += sizeof(double) * inputData_pinPositionAmount(data);
+
     const uint64_t imageSize = data->header->imageWidth * data->header->imageWidth;
 
     data->target = (Color*)memory;
     memory += sizeof(Color) * imageSize;
 
-    data->importance = (double*)memory;
-    memory += sizeof(double) * imageSize;
+    data->importance = (void*)memory;
+    memory += data->header->importanceFormat.bytesPerWeight * imageSize;
 
     DEBUG_EXIT_FUNC();
     return memory;
@@ -41,7 +114,7 @@ void _output_data_initialize(
     DEBUG_ENTER_FUNC();
 
     data->header = (OutputHeader*)memory;
-    memory += sizeof(data->header);
+    memory += sizeof(*(data->header));
 
     const uint64_t imageSize = inputHeader->imageWidth * inputHeader->imageWidth;
 
@@ -86,6 +159,16 @@ bool sharedData_attach(SharedData *sharedData, key_t key, size_t size) {
         return false;
     }
 
+    const uint8_t bytesPerWeight = (
+        ((InputHeader*)(sharedData->memory))->importanceFormat.bytesPerWeight
+    );
+    if (bytesPerWeight != sizeof(uint8_t) && bytesPerWeight != sizeof(uint16_t)) {
+        errno = EINVAL;
+        PRINT_ERROR("importance weights have to be 1 or 2 bytes wide");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
     uint8_t *memory = _input_data_initialize(
         &(sharedData->inputData), (uint8_t*)(sharedData->memory)
     );
@@ -99,6 +182,142 @@ bool sharedData_attach(SharedData *sharedData, key_t key, size_t size) {
     return true;
 }
 
+bool sharedData_downsample(
+    SharedData *sharedData,
+    const SharedData *source,
+    uint64_t downscaleFactor,
+    uint64_t maxIterations
+) {
+    DEBUG_ENTER_FUNC();
+    const InputHeader *sourceHeader = source->inputData.header;
+    const uint64_t sourceWidth = sourceHeader->imageWidth;
+    const uint64_t imageWidth = sourceWidth / downscaleFactor;
+    const uint64_t imageSize = imageWidth * imageWidth;
+    const uint64_t threadAmount = sourceHeader->indexer.threadAmount;
+    const uint64_t pinPositionAmount = inputData_pinPositionAmount(
+        &(source->inputData)
+    );
+
+    // same layout as the shared memory, kept in the heap
+    const size_t size = (
+        sizeof(InputHeader)
+        + sizeof(Thread) * threadAmount
+        + sizeof(uint64_t) * sourceHeader->threadOrderSize
+        + sizeof(uint64_t) * threadAmount
+        + sizeof(double) * pinPositionAmount
+        + (sizeof(Color) + sourceHeader->importanceFormat.bytesPerWeight) * imageSize
+        + sizeof(OutputHeader)
+        + sizeof(Color) * imageSize
+        + sizeof(Instruction) * maxIterations
+    );
+    sharedData->memory = calloc(1, size);
+    if (!sharedData->memory) {
+        PRINT_ERROR("error while allocating downsampled sharedData->memory");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    InputHeader *header = (InputHeader*)(sharedData->memory);
+    *header = *sourceHeader;
+    header->imageWidth = imageWidth;
+    header->debugFlags = 0;
+    header->termination.maxIterations = maxIterations;
+    header->pyramid.downscaleFactor = 1;
+
+    uint8_t *memory = _input_data_initialize(
+        &(sharedData->inputData), (uint8_t*)(sharedData->memory)
+    );
+    _output_data_initialize(&(sharedData->outputData), memory, header);
+
+    memcpy(
+        (void*)sharedData->inputData.threads,
+        (const void*)source->inputData.threads,
+        sizeof(Thread) * threadAmount
+    );
+    memcpy(
+        (void*)sharedData->inputData.threadOrder,
+        (const void*)source->inputData.threadOrder,
+        sizeof(uint64_t) * sourceHeader->threadOrderSize
+    );
+    memcpy(
+        (void*)sharedData->inputData.startPoints,
+        (const void*)source->inputData.startPoints,
+        sizeof(uint64_t) * threadAmount
+    );
+
+    // pin positions are in pixels and scale with the image
+    const double positionScale = (double)imageWidth / (double)sourceWidth;
+    for (uint64_t i = 0; i < pinPositionAmount; ++i) {
+        double position = 0.0;
+        memcpy(
+            (void*)&position,
+            (const void*)&(source->inputData.pinPositions[i]),
+            sizeof(double)
+        );
+        position *= positionScale;
+        memcpy(
+            (void*)&(sharedData->inputData.pinPositions[i]),
+            (const void*)&position,
+            sizeof(double)
+        );
+    }
+
+    // box filter over downscaleFactor x downscaleFactor source pixels
+    const uint64_t blockSize = downscaleFactor * downscaleFactor;
+    for (uint64_t y = 0; y < imageWidth; ++y) {
+        for (uint64_t x = 0; x < imageWidth; ++x) {
+            uint64_t c = 0;
+            uint64_t m = 0;
+            uint64_t k = 0;
+            uint64_t weight = 0;
+            for (uint64_t j = 0; j < downscaleFactor; ++j) {
+                for (uint64_t i = 0; i < downscaleFactor; ++i) {
+                    const uint64_t sourceIndex = (
+                        (y * downscaleFactor + j) * sourceWidth
+                        + x * downscaleFactor + i
+                    );
+                    const Color *color = &(source->inputData.target[sourceIndex]);
+                    c += color->c;
+                    m += color->m;
+                    k += color->y;
+                    weight += inputData_importanceWeight(
+                        &(source->inputData), sourceIndex
+                    );
+                }
+            }
+            const uint64_t index = y * imageWidth + x;
+            sharedData->inputData.target[index] = (Color){
+                .c = (uint8_t)((c + blockSize / 2) / blockSize),
+                .m = (uint8_t)((m + blockSize / 2) / blockSize),
+                .y = (uint8_t)((k + blockSize / 2) / blockSize)
+            };
+            weight = (weight + blockSize / 2) / blockSize;
+            if (header->importanceFormat.bytesPerWeight == sizeof(uint16_t)) {
+                const uint16_t weight16 = (uint16_t)weight;
+                memcpy(
+                    (uint8_t*)(sharedData->inputData.importance) + index * sizeof(uint16_t),
+                    (const void*)&weight16,
+                    sizeof(uint16_t)
+                );
+            } else {
+                ((uint8_t*)(sharedData->inputData.importance))[index] = (
+                    (uint8_t)weight
+                );
+            }
+        }
+    }
+
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+void sharedData_free(SharedData *sharedData) {
+    DEBUG_ENTER_FUNC();
+    free(sharedData->memory);
+    sharedData->memory = NULL;
+    DEBUG_EXIT_FUNC();
+}
+
 bool sharedData_detach(SharedData *sharedData) {
     DEBUG_ENTER_FUNC();
     // if (shmdt(sharedData->memory) == -1) {
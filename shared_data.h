@@ -14,6 +14,19 @@
 #define TERMINATE_ON_MIN_RELATIVE_ERROR (0b00000001)
 #define TERMINATE_ON_UNAVAILABLE_CONNECTION (0b00000010)
 
+#define OPTIMIZATION_LINE_ATLAS (0b00000001)
+// Approximate: stale cached error deltas are used as if they were lower
+// bounds, which the objective does not guarantee, so the chosen lines can
+// differ from exhaustive evaluation. On reference runs (64 to 256 pixels,
+// 30 to 200 pins) 0.2 to 0.5% of the iterations committed a line that was
+// not the argmin, losing 0.05 to 0.6% of the exhaustive error reduction.
+#define OPTIMIZATION_LAZY_GREEDY (0b00000010)
+#define OPTIMIZATION_SPATIAL_INDEX (0b00000100)
+#define OPTIMIZATION_NUMA (0b00001000)
+
+#define PIN_LAYOUT_CIRCLE (0)
+#define PIN_LAYOUT_CUSTOM (1)
+
 #pragma region InputData
 
 #pragma pack(1)
@@ -36,14 +49,50 @@ typedef struct {
     uint64_t relativeErrorStreak;
 } Termination;
 
+// width 1 and depth 1 (or 0) select the plain one step greedy search
+#pragma pack(1)
+typedef struct {
+    uint64_t width;
+    uint64_t depth;
+} BeamSearch;
+
+// the first coarseIterationRatio of the iterations run on an image
+// downscaled by downscaleFactor, a factor of 0 or 1 disables this
+#pragma pack(1)
+typedef struct {
+    uint64_t downscaleFactor;
+    double coarseIterationRatio;
+} Pyramid;
+
+// the importance of a pixel is its unsigned integer weight times scale,
+// weights are stored with bytesPerWeight (1 or 2) bytes each
+#pragma pack(1)
+typedef struct {
+    uint8_t bytesPerWeight;
+    double scale;
+} ImportanceFormat;
+
+// circular layouts space the pins evenly on the border of the disc, custom
+// layouts give the x and y position of every pin in pixels, see
+// InputData.pinPositions, and use the whole image as the canvas
+#pragma pack(1)
+typedef struct {
+    uint8_t kind;
+} PinLayout;
+
 #pragma pack(1)
 typedef struct {
     uint64_t imageWidth;
     uint64_t threadOrderSize;
     uint8_t debugFlags;
+    uint8_t optimizationFlags;
     Disc disc;
     Indexer indexer;
     Termination termination;
+    BeamSearch beamSearch;
+    Pyramid pyramid;
+    ImportanceFormat importanceFormat;
+    PinLayout pinLayout;
 } InputHeader;
 
 #pragma pack(1)
@@ -59,8 +108,9 @@ typedef struct {
     Thread *threads;
     uint64_t *threadOrder;
     uint64_t *startPoints;
+    double *pinPositions;
     Color *target;
-    double *importance;
+    void *importance;
 } InputData;
 
 #pragma endregion
@@ -72,6 +122,11 @@ typedef struct {
     uint64_t instructionAmount;
     uint64_t absoluteError;
     double normalizedError;
+    // the worker amount and candidate chunk size the last iteration's
+    // candidate evaluation ran with, which is the locked configuration
+    // unless the run ended while tuning
+    uint64_t workerAmount;
+    uint64_t candidateChunkSize;
 } OutputHeader;
 
 #pragma pack(1)
@@ -104,7 +159,32 @@ typedef struct {
     OutputData outputData;
 } SharedData;
 
+uint64_t indexer_pairAmount(const Indexer *self);
+uint64_t indexer_pairIndex(
+    const Indexer *self,
+    uint64_t pointIndex1,
+    uint64_t pointIndex2
+);
+void indexer_pointPosition(
+    const Indexer *self,
+    uint64_t imageWidth,
+    uint64_t pointIndex,
+    double *x,
+    double *y
+);
+
+uint64_t inputData_pinPositionAmount(const InputData *self);
+uint16_t inputData_importanceWeight(const InputData *self, uint64_t index);
+
 bool sharedData_attach(SharedData *sharedData, key_t key, size_t size);
 bool sharedData_detach(SharedData *sharedData);
 
+bool sharedData_downsample(
+    SharedData *sharedData,
+    const SharedData *source,
+    uint64_t downscaleFactor,
+    uint64_t maxIterations
+);
+void sharedData_free(SharedData *sharedData);
+
 #endif // __SHARED_DATA_H__
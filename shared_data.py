@@ -2,7 +2,7 @@ from __future__ import annotations
 
 import ctypes
 import struct
-from typing import Any, List, Tuple
+from typing import Any, List, Optional, Tuple
 
 import numpy as np
 import sysv_ipc
@@ -18,6 +18,26 @@ DEBUG_STORE_ABSOLUTE_ERRORS: int = 0b00000010
 TERMINATE_ON_MIN_RELATIVE_ERROR: int = 0b00000001
 TERMINATE_ON_UNAVAILABLE_CONNECTION: int = 0b00000010
 
+OPTIMIZATION_LINE_ATLAS: int = 0b00000001
+# approximate, can choose other lines than exhaustive evaluation, see
+# OPTIMIZATION_LAZY_GREEDY in shared_data.h
+OPTIMIZATION_LAZY_GREEDY: int = 0b00000010
+OPTIMIZATION_SPATIAL_INDEX: int = 0b00000100
+OPTIMIZATION_NUMA: int = 0b00001000
+
+PIN_LAYOUT_CIRCLE: int = 0
+PIN_LAYOUT_CUSTOM: int = 1
+
+
+def quantize_importance(
+    importance: np.array, dtype: np.dtype = np.uint16
+) -> Tuple[np.array, float]:
+    max_weight = np.iinfo(dtype).max
+    max_importance = float(np.max(importance))
+    scale = max_importance / max_weight if max_importance > 0.0 else 1.0
+    weights = np.rint(np.asarray(importance) / scale).astype(dtype)
+    return weights, scale
+
 
 class Thread:
     _alpha: int
@@ -54,6 +74,7 @@ class InputData:
     _image_width: int
     _thread_order_size: int
     _debug_flags: int
+    _optimization_flags: int
     _radius_in_micrometers: int
     _background_color: np.array
     _point_amount: int
@@ -62,11 +83,18 @@ class InputData:
     _max_iterations: int
     _min_relative_error: float
     _relative_error_streak: int
+    _beam_width: int
+    _beam_depth: int
+    _pyramid_downscale_factor: int
+    _pyramid_coarse_iteration_ratio: float
     _threads: List[Thread]
     _thread_order: List[int]
     _start_points: List[int]
     _target: np.array
     _importance: np.array
+    _importance_scale: float
+    _pin_layout: int
+    _pin_positions: Optional[np.array]
 
     _output_data: OutputData
     _memory_size: int
@@ -76,6 +104,10 @@ class InputData:
         image_width: int,
         debug_store_images: bool,
         debug_store_absolute_errors: bool,
+        use_line_atlas: bool,
+        use_lazy_greedy: bool,
+        use_spatial_index: bool,
+        use_numa: bool,
         radius_in_micrometers: int,
         background_color: np.array,
         point_amount: int,
@@ -84,11 +116,17 @@ class InputData:
         max_iterations: int,
         min_relative_error: float,
         relative_error_streak: int,
+        beam_width: int,
+        beam_depth: int,
+        pyramid_downscale_factor: int,
+        pyramid_coarse_iteration_ratio: float,
         threads: List[Thread],
         thread_order: List[int],
         start_points: List[int],
         target: np.array,
         importance: np.array,
+        importance_scale: float,
+        pin_positions: Optional[np.array] = None,
     ):
         self._image_width = image_width
         self._thread_order_size = len(thread_order)
@@ -102,6 +140,24 @@ class InputData:
                 if debug_store_absolute_errors else 0
             )
         )
+        self._optimization_flags = (
+            (
+                OPTIMIZATION_LINE_ATLAS
+                if use_line_atlas else 0
+            )
+            | (
+                OPTIMIZATION_LAZY_GREEDY
+                if use_lazy_greedy else 0
+            )
+            | (
+                OPTIMIZATION_SPATIAL_INDEX
+                if use_spatial_index else 0
+            )
+            | (
+                OPTIMIZATION_NUMA
+                if use_numa else 0
+            )
+        )
         self._radius_in_micrometers = radius_in_micrometers
         self._background_color = background_color
         self._point_amount = point_amount
@@ -119,11 +175,36 @@ class InputData:
         self._max_iterations = max_iterations
         self._min_relative_error = min_relative_error
         self._relative_error_streak = relative_error_streak
+        self._beam_width = beam_width
+        self._beam_depth = beam_depth
+        self._pyramid_downscale_factor = pyramid_downscale_factor
+        self._pyramid_coarse_iteration_ratio = pyramid_coarse_iteration_ratio
         self._threads = threads
         self._thread_order = thread_order
         self._start_points = start_points
         self._target = target
+        if importance.dtype not in (np.uint8, np.uint16):
+            raise TypeError(
+                "importance has to be given as uint8 or uint16 weights, "
+                "see quantize_importance"
+            )
         self._importance = importance
+        self._importance_scale = importance_scale
+        # x and y in pixels per pin for non-circular frames, the whole image
+        # is used as the canvas then
+        if pin_positions is None:
+            self._pin_layout = PIN_LAYOUT_CIRCLE
+            self._pin_positions = None
+        else:
+            pin_positions = np.ascontiguousarray(
+                pin_positions, dtype=np.float64
+            )
+            if pin_positions.shape != (point_amount, 2):
+                raise ValueError(
+                    "pin_positions has to hold an x and y position per pin"
+                )
+            self._pin_layout = PIN_LAYOUT_CUSTOM
+            self._pin_positions = pin_positions
 
         self._output_data = OutputData(self)
         self._memory_size = None
@@ -132,14 +213,23 @@ class InputData:
     def memory_size(self) -> int:
         return (
             SIZEOF_UINT64_T + SIZEOF_UINT64_T + SIZEOF_UINT8_T
+            + SIZEOF_UINT8_T
             + SIZEOF_UINT64_T + SIZEOF_COLOR + SIZEOF_UINT64_T
             + SIZEOF_UINT64_T + SIZEOF_UINT8_T + SIZEOF_UINT64_T
             + SIZEOF_DOUBLE + SIZEOF_UINT64_T
+            + SIZEOF_UINT64_T + SIZEOF_UINT64_T
+            + SIZEOF_UINT64_T + SIZEOF_DOUBLE
+            + SIZEOF_UINT8_T + SIZEOF_DOUBLE
+            + SIZEOF_UINT8_T
             + self._thread_amount * (
                 SIZEOF_UINT64_T + SIZEOF_UINT64_T + SIZEOF_COLOR
             )
             + self._thread_order_size * SIZEOF_UINT64_T
             + self._thread_amount * SIZEOF_UINT64_T
+            + (
+                self._pin_positions.nbytes
+                if self._pin_positions is not None else 0
+            )
             + self._target.nbytes
             + self._importance.nbytes
         )
@@ -159,6 +249,7 @@ class InputData:
         offset = self._pack("Q", buffer, offset, self._image_width)
         offset = self._pack("Q", buffer, offset, self._thread_order_size)
         offset = self._pack("B", buffer, offset, self._debug_flags)
+        offset = self._pack("B", buffer, offset, self._optimization_flags)
         offset = self._pack("Q", buffer, offset, self._radius_in_micrometers)
         offset = self._pack(
             "3s", buffer, offset, self._background_color.tobytes()
@@ -169,6 +260,17 @@ class InputData:
         offset = self._pack("Q", buffer, offset, self._max_iterations)
         offset = self._pack("d", buffer, offset, self._min_relative_error)
         offset = self._pack("Q", buffer, offset, self._relative_error_streak)
+        offset = self._pack("Q", buffer, offset, self._beam_width)
+        offset = self._pack("Q", buffer, offset, self._beam_depth)
+        offset = self._pack(
+            "Q", buffer, offset, self._pyramid_downscale_factor
+        )
+        offset = self._pack(
+            "d", buffer, offset, self._pyramid_coarse_iteration_ratio
+        )
+        offset = self._pack("B", buffer, offset, self._importance.itemsize)
+        offset = self._pack("d", buffer, offset, self._importance_scale)
+        offset = self._pack("B", buffer, offset, self._pin_layout)
         for thread in self._threads:
             offset = self._pack("B", buffer, offset, thread._alpha)
             offset = self._pack(
@@ -179,11 +281,16 @@ class InputData:
             offset = self._pack("Q", buffer, offset, thread_id)
         for start_point in self._start_points:
             offset = self._pack("Q", buffer, offset, start_point)
+        if self._pin_positions is not None:
+            offset = self._pack(
+                f"{self._pin_positions.nbytes}s", buffer, offset,
+                self._pin_positions.tobytes()
+            )
         offset = self._pack(
             f"{self._target.size}s", buffer, offset, self._target.tobytes()
         )
         offset = self._pack(
-            f"{self._importance.size}s", buffer, offset,
+            f"{self._importance.nbytes}s", buffer, offset,
             self._importance.tobytes()
         )
         self._memory_size = offset
@@ -231,6 +338,8 @@ class OutputData:
     _instruction_amount: int
     _absolute_error: int
     _normalized_error: float
+    _worker_amount: int
+    _candidate_chunk_size: int
     _result: np.array
     _instructions: List[Instruction]
     _debug_images: List[np.array]
@@ -246,6 +355,7 @@ class OutputData:
     def memory_size(self) -> int:
         size = (
             SIZEOF_UINT64_T + SIZEOF_UINT64_T + SIZEOF_DOUBLE
+            + SIZEOF_UINT64_T + SIZEOF_UINT64_T
             + self._image_width ** 2 * SIZEOF_COLOR
             + self._max_iterations * Instruction.SIZE
         )
@@ -274,6 +384,16 @@ class OutputData:
     def normalized_error(self) -> float:
         return self._normalized_error
 
+    # worker amount and candidate chunk size the last iteration ran with,
+    # the locked tuning unless the run ended while tuning
+    @property
+    def worker_amount(self) -> int:
+        return self._worker_amount
+
+    @property
+    def candidate_chunk_size(self) -> int:
+        return self._candidate_chunk_size
+
     @property
     def result(self) -> np.array:
         return self._result
@@ -313,6 +433,10 @@ class OutputData:
         offset, self._instruction_amount = self._unpack("Q", buffer, offset)
         offset, self._absolute_error = self._unpack("Q", buffer, offset)
         offset, self._normalized_error = self._unpack("d", buffer, offset)
+        offset, self._worker_amount = self._unpack("Q", buffer, offset)
+        offset, self._candidate_chunk_size = self._unpack(
+            "Q", buffer, offset
+        )
         offset, self._result = self._unpack_array(
             buffer, np.uint8, self._image_width ** 2 * SIZEOF_COLOR, offset,
             (self._image_width, self._image_width, SIZEOF_COLOR)
@@ -0,0 +1,233 @@
+#include "spatial_index.h"
+
+#include "error_handling.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+void _spatialIndex_markTile(
+    SpatialIndex *self,
+    uint64_t tileIndex,
+    uint64_t pairIndex,
+    uint64_t *tileCursors
+) {
+    DEBUG_ENTER_FUNC();
+    // the first pass counts into tileOffsets, the second one fills
+    if (tileCursors) {
+        self->pairIndices[tileCursors[tileIndex]++] = (uint32_t)pairIndex;
+    } else {
+        ++(self->tileOffsets[tileIndex + 1]);
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void _spatialIndex_markLine(
+    SpatialIndex *self,
+    double x0,
+    double y0,
+    double x1,
+    double y1,
+    double thicknessInPixels,
+    uint64_t pairIndex,
+    uint64_t *tileCursors
+) {
+    DEBUG_ENTER_FUNC();
+    // Conservative tile cover of a thick line: for every tile column along
+    // the major axis take the minor axis extent of the center line there,
+    // padded by half the widened thickness plus the rasterizer's rounding.
+    const bool isSteep = fabs(y1 - y0) > fabs(x1 - x0);
+    double u0 = isSteep ? y0 : x0;
+    double v0 = isSteep ? x0 : y0;
+    double u1 = isSteep ? y1 : x1;
+    double v1 = isSteep ? x1 : y1;
+    if (u0 > u1) {
+        double temp = u0;
+        u0 = u1;
+        u1 = temp;
+        temp = v0;
+        v0 = v1;
+        v1 = temp;
+    }
+    const double gradient = (u1 > u0) ? (v1 - v0) / (u1 - u0) : 0.0;
+    const double padding = (
+        0.5 * thicknessInPixels * sqrt(1.0 + gradient * gradient) + 2.0
+    );
+    const double tileSize = (double)SPATIAL_INDEX_TILE_SIZE;
+    const int64_t lastTile = (int64_t)self->tilesPerRow - 1;
+
+    int64_t firstColumn = (int64_t)floor((u0 - 1.0) / tileSize);
+    int64_t lastColumn = (int64_t)floor((u1 + 1.0) / tileSize);
+    if (firstColumn < 0) firstColumn = 0;
+    if (lastColumn > lastTile) lastColumn = lastTile;
+
+    for (int64_t column = firstColumn; column <= lastColumn; ++column) {
+        const double uA = fmax(u0, (double)column * tileSize);
+        const double uB = fmin(u1, (double)(column + 1) * tileSize);
+        const double vA = v0 + gradient * (uA - u0);
+        const double vB = v0 + gradient * (uB - u0);
+        int64_t firstRow = (int64_t)floor((fmin(vA, vB) - padding) / tileSize);
+        int64_t lastRow = (int64_t)floor((fmax(vA, vB) + padding) / tileSize);
+        if (firstRow < 0) firstRow = 0;
+        if (lastRow > lastTile) lastRow = lastTile;
+        for (int64_t row = firstRow; row <= lastRow; ++row) {
+            const uint64_t tileIndex = isSteep
+                ? (uint64_t)(column * (lastTile + 1) + row)
+                : (uint64_t)(row * (lastTile + 1) + column);
+            _spatialIndex_markTile(self, tileIndex, pairIndex, tileCursors);
+        }
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void _spatialIndex_markLines(
+    SpatialIndex *self,
+    const Indexer *indexer,
+    const PinTable *pinTable,
+    double thicknessInPixels,
+    uint64_t *tileCursors
+) {
+    DEBUG_ENTER_FUNC();
+    for (uint64_t i = 0; i < indexer->pointAmount; ++i) {
+        double x0 = 0.0;
+        double y0 = 0.0;
+        pinTable_position(pinTable, i, &x0, &y0);
+        for (uint64_t j = i + 1; j < indexer->pointAmount; ++j) {
+            double x1 = 0.0;
+            double y1 = 0.0;
+            pinTable_position(pinTable, j, &x1, &y1);
+            _spatialIndex_markLine(
+                self, x0, y0, x1, y1, thicknessInPixels,
+                indexer_pairIndex(indexer, i, j), tileCursors
+            );
+        }
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+SpatialIndex * spatialIndex_new(
+    uint64_t imageWidth,
+    const Indexer *indexer,
+    const PinTable *pinTable,
+    double thicknessInPixels
+) {
+    DEBUG_ENTER_FUNC();
+    SpatialIndex *spatialIndex = (SpatialIndex*)calloc(1, sizeof(SpatialIndex));
+    if (!spatialIndex) {
+        PRINT_ERROR("error while allocating spatialIndex");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    uint64_t *tileCursors = NULL;
+    spatialIndex->imageWidth = imageWidth;
+    spatialIndex->tilesPerRow = (
+        (imageWidth + SPATIAL_INDEX_TILE_SIZE - 1) / SPATIAL_INDEX_TILE_SIZE
+    );
+    spatialIndex->tileAmount = (
+        spatialIndex->tilesPerRow * spatialIndex->tilesPerRow
+    );
+    spatialIndex->pairAmount = indexer_pairAmount(indexer);
+
+    spatialIndex->tileOffsets = (uint64_t*)calloc(
+        spatialIndex->tileAmount + 1, sizeof(uint64_t)
+    );
+    if (!spatialIndex->tileOffsets) {
+        PRINT_ERROR("error while allocating spatialIndex->tileOffsets");
+        goto ERROR;
+    }
+
+    spatialIndex->tileStamps = (uint64_t*)calloc(
+        spatialIndex->tileAmount, sizeof(uint64_t)
+    );
+    if (!spatialIndex->tileStamps) {
+        PRINT_ERROR("error while allocating spatialIndex->tileStamps");
+        goto ERROR;
+    }
+
+    _spatialIndex_markLines(
+        spatialIndex, indexer, pinTable, thicknessInPixels, NULL
+    );
+    for (uint64_t i = 0; i < spatialIndex->tileAmount; ++i) {
+        spatialIndex->tileOffsets[i + 1] += spatialIndex->tileOffsets[i];
+    }
+    DEBUG_PRINT(
+        "spatialIndex entries: %ld\n",
+        spatialIndex->tileOffsets[spatialIndex->tileAmount]
+    );
+
+    spatialIndex->pairIndices = (uint32_t*)malloc(
+        spatialIndex->tileOffsets[spatialIndex->tileAmount] * sizeof(uint32_t)
+    );
+    if (!spatialIndex->pairIndices) {
+        PRINT_ERROR("error while allocating spatialIndex->pairIndices");
+        goto ERROR;
+    }
+
+    tileCursors = (uint64_t*)malloc(spatialIndex->tileAmount * sizeof(uint64_t));
+    if (!tileCursors) {
+        PRINT_ERROR("error while allocating tileCursors");
+        goto ERROR;
+    }
+    for (uint64_t i = 0; i < spatialIndex->tileAmount; ++i) {
+        tileCursors[i] = spatialIndex->tileOffsets[i];
+    }
+    _spatialIndex_markLines(
+        spatialIndex, indexer, pinTable, thicknessInPixels, tileCursors
+    );
+    free(tileCursors);
+
+    spatialIndex->currentStamp = 0;
+
+    DEBUG_EXIT_FUNC();
+    return spatialIndex;
+
+ERROR:
+    free(tileCursors);
+    spatialIndex_delete(spatialIndex);
+    DEBUG_EXIT_FUNC();
+    return NULL;
+}
+
+void spatialIndex_delete(SpatialIndex *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->tileStamps);
+        free(self->pairIndices);
+        free(self->tileOffsets);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void spatialIndex_invalidate(
+    SpatialIndex *self,
+    const PixelDelta *pixelDelta,
+    bool *pairIsExact,
+    uint64_t threadAmount
+) {
+    DEBUG_ENTER_FUNC();
+    ++(self->currentStamp);
+    for (uint64_t i = 0; i < pixelDelta->changeAmount; ++i) {
+        const uint64_t imageIndex = pixelDelta->imageIndices[i];
+        const uint64_t tileIndex = (
+            (imageIndex / self->imageWidth / SPATIAL_INDEX_TILE_SIZE) * self->tilesPerRow
+            + (imageIndex % self->imageWidth) / SPATIAL_INDEX_TILE_SIZE
+        );
+        if (self->tileStamps[tileIndex] == self->currentStamp) {
+            continue;
+        }
+        self->tileStamps[tileIndex] = self->currentStamp;
+        for (
+            uint64_t j = self->tileOffsets[tileIndex];
+            j < self->tileOffsets[tileIndex + 1];
+            ++j
+        ) {
+            const uint64_t pairIndex = self->pairIndices[j];
+            for (uint64_t t = 0; t < threadAmount; ++t) {
+                pairIsExact[t * self->pairAmount + pairIndex] = false;
+            }
+        }
+    }
+    DEBUG_EXIT_FUNC();
+}
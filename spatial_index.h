@@ -0,0 +1,43 @@
+#ifndef __SPATIAL_INDEX_H__
+#define __SPATIAL_INDEX_H__
+
+#include "shared_data.h"
+#include "pin_table.h"
+#include "pixel_delta.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef SPATIAL_INDEX_TILE_SIZE
+#define SPATIAL_INDEX_TILE_SIZE (16)
+#endif // SPATIAL_INDEX_TILE_SIZE
+
+// Maps every image tile to the pin pairs whose line passes through it.
+// The pairs of tile t are pairIndices[tileOffsets[t] .. tileOffsets[t + 1]].
+typedef struct {
+    uint64_t imageWidth;
+    uint64_t tilesPerRow;
+    uint64_t tileAmount;
+    uint64_t pairAmount;
+    uint64_t *tileOffsets;
+    uint32_t *pairIndices;
+    uint64_t *tileStamps;
+    uint64_t currentStamp;
+} SpatialIndex;
+
+SpatialIndex * spatialIndex_new(
+    uint64_t imageWidth,
+    const Indexer *indexer,
+    const PinTable *pinTable,
+    double thicknessInPixels
+);
+void spatialIndex_delete(SpatialIndex *self);
+
+void spatialIndex_invalidate(
+    SpatialIndex *self,
+    const PixelDelta *pixelDelta,
+    bool *pairIsExact,
+    uint64_t threadAmount
+);
+
+#endif // __SPATIAL_INDEX_H__
@@ -1,13 +1,328 @@
 #include "worker_pool.h"
+#include "numa_memory.h"
 #include "error_handling.h"
 #include "debug.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
-#define WAKEUP_SIGNAL (SIGUSR1)
-#define TERMINATION_SIGNAL (SIGUSR2)
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+void _workerPool_waiterInitialize(
+    WorkerPoolWaiter *waiter,
+    size_t coreAmount
+) {
+    DEBUG_ENTER_FUNC();
+    waiter->sense = 0;
+    // with a single core the released thread can only run after the
+    // polling one gave up its time slice, so polling never pays off there;
+    // a spin count of 0 stays 0
+    waiter->spinCount = coreAmount > 1 ? WORKER_POOL_MIN_SPIN_COUNT : 0;
+    DEBUG_EXIT_FUNC();
+}
+
+bool _workerPool_readLong(const char *path, long *value) {
+    DEBUG_ENTER_FUNC();
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    const bool result = fscanf(file, "%ld", value) == 1;
+    fclose(file);
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+// quota and period of a cgroup v2 cpu.max file, false if it is unlimited
+bool _workerPool_readCpuMax(const char *path, long *quota, long *period) {
+    DEBUG_ENTER_FUNC();
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    char quotaString[32];
+    const bool result = (
+        fscanf(file, "%31s %ld", quotaString, period) == 2
+        && strcmp(quotaString, "max") != 0
+    );
+    fclose(file);
+    if (result) {
+        *quota = strtol(quotaString, NULL, 10);
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+// The CPUs the cgroup CPU quota allows, rounded up, or 0 without a quota.
+// With cgroup v2 the tightest quota of the process' cgroup and its
+// ancestors applies.
+size_t _workerPool_quotaCpuAmount(void) {
+    DEBUG_ENTER_FUNC();
+    size_t result = 0;
+    long quota = 0;
+    long period = 0;
+
+    char cgroupPath[PATH_MAX] = "";
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (file) {
+        char line[PATH_MAX];
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "0::", 3) == 0) {
+                line[strcspn(line, "\n")] = '\0';
+                snprintf(cgroupPath, sizeof(cgroupPath), "%s", line + 3);
+                break;
+            }
+        }
+        fclose(file);
+    }
+    while (true) {
+        char path[PATH_MAX];
+        snprintf(
+            path, sizeof(path), WORKER_POOL_CGROUP_DIRECTORY "%s/cpu.max",
+            strcmp(cgroupPath, "/") == 0 ? "" : cgroupPath
+        );
+        if (_workerPool_readCpuMax(path, &quota, &period) && quota > 0 && period > 0) {
+            const size_t cpuAmount = (size_t)((quota + period - 1) / period);
+            if (result == 0 || cpuAmount < result) {
+                result = cpuAmount;
+            }
+        }
+        char *separator = strrchr(cgroupPath, '/');
+        if (!separator || cgroupPath[0] == '\0') {
+            break;
+        }
+        *separator = '\0';
+    }
+
+    if (
+        result == 0
+        && _workerPool_readLong(WORKER_POOL_CGROUP_DIRECTORY "/cpu/cpu.cfs_quota_us", &quota)
+        && _workerPool_readLong(WORKER_POOL_CGROUP_DIRECTORY "/cpu/cpu.cfs_period_us", &period)
+        && quota > 0 && period > 0
+    ) {
+        result = (size_t)((quota + period - 1) / period);
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+int _workerPool_compareCpus(const void *a, const void *b) {
+    DEBUG_ENTER_FUNC();
+    const WorkerPoolCpu *cpuA = (const WorkerPoolCpu*)a;
+    const WorkerPoolCpu *cpuB = (const WorkerPoolCpu*)b;
+    int result = 0;
+    if (cpuA->rank != cpuB->rank) {
+        result = cpuA->rank < cpuB->rank ? -1 : 1;
+    } else if (cpuA->cpuIndex != cpuB->cpuIndex) {
+        result = cpuA->cpuIndex < cpuB->cpuIndex ? -1 : 1;
+    }
+    DEBUG_EXIT_FUNC();
+    return result;
+}
+
+// The allowed CPUs with their physical cores, fastest first. CPUs missing
+// from the ranking follow the ranked ones; without topology information
+// every CPU counts as a core of its own.
+WorkerPoolCpu * _workerPool_listCpus(size_t *cpuAmount) {
+    DEBUG_ENTER_FUNC();
+    cpu_set_t cpuSet;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet)) {
+        PRINT_ERROR("error getting CPU affinity");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    WorkerPoolCpu *cpus = (WorkerPoolCpu*)malloc(
+        CPU_COUNT(&cpuSet) * sizeof(WorkerPoolCpu)
+    );
+    if (!cpus) {
+        PRINT_ERROR("error allocating cpus");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    *cpuAmount = 0;
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+        if (!CPU_ISSET(i, &cpuSet)) {
+            continue;
+        }
+        WorkerPoolCpu *cpu = &(cpus[(*cpuAmount)++]);
+        *cpu = (WorkerPoolCpu){
+            .cpuIndex = i,
+            .rank = INT_MAX,
+            .packageId = -1,
+            .coreId = i
+        };
+        char path[PATH_MAX];
+        snprintf(
+            path, sizeof(path),
+            WORKER_POOL_CPU_DIRECTORY "/cpu%d/topology/physical_package_id", i
+        );
+        long packageId = 0;
+        long coreId = 0;
+        if (_workerPool_readLong(path, &packageId)) {
+            snprintf(
+                path, sizeof(path),
+                WORKER_POOL_CPU_DIRECTORY "/cpu%d/topology/core_id", i
+            );
+            if (_workerPool_readLong(path, &coreId)) {
+                cpu->packageId = packageId;
+                cpu->coreId = coreId;
+            }
+        }
+    }
+
+    FILE *file = fopen(WORKER_POOL_CORE_RANKING_FILE, "r");
+    if (file) {
+        char line[256];
+        int rank = 0;
+        while (fgets(line, sizeof(line), file)) {
+            int cpuIndex = 0;
+            if (sscanf(line, "Core %d:", &cpuIndex) != 1) {
+                continue;
+            }
+            for (size_t i = 0; i < *cpuAmount; ++i) {
+                if (cpus[i].cpuIndex == cpuIndex && cpus[i].rank == INT_MAX) {
+                    cpus[i].rank = rank;
+                }
+            }
+            ++rank;
+        }
+        fclose(file);
+    }
+
+    qsort(cpus, *cpuAmount, sizeof(WorkerPoolCpu), _workerPool_compareCpus);
+    DEBUG_EXIT_FUNC();
+    return cpus;
+}
+
+// Fills cpuIndices round by round. A round takes the fastest free CPU of
+// every physical core not used in that round yet, so hardware threads of
+// one core are only shared once every core has a worker. More workers
+// than CPUs start over with all CPUs.
+bool _workerPool_placeWorkers(WorkerPool *self) {
+    DEBUG_ENTER_FUNC();
+    size_t cpuAmount = 0;
+    WorkerPoolCpu *cpus = _workerPool_listCpus(&cpuAmount);
+    if (!cpus || cpuAmount == 0) {
+        free(cpus);
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    size_t *takenRounds = (size_t*)calloc(cpuAmount, sizeof(size_t));
+    if (!takenRounds) {
+        free(cpus);
+        PRINT_ERROR("error allocating takenRounds");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+
+    size_t workerIndex = 0;
+    size_t takenAmount = 0;
+    for (size_t round = 1; workerIndex < self->workerAmount; ++round) {
+        if (takenAmount == cpuAmount) {
+            memset((void*)takenRounds, 0, cpuAmount * sizeof(size_t));
+            takenAmount = 0;
+        }
+        for (size_t i = 0; i < cpuAmount && workerIndex < self->workerAmount; ++i) {
+            if (takenRounds[i]) {
+                continue;
+            }
+            bool isCoreUsed = false;
+            for (size_t j = 0; j < cpuAmount; ++j) {
+                if (
+                    takenRounds[j] == round
+                    && cpus[j].packageId == cpus[i].packageId
+                    && cpus[j].coreId == cpus[i].coreId
+                ) {
+                    isCoreUsed = true;
+                    break;
+                }
+            }
+            if (isCoreUsed) {
+                continue;
+            }
+            takenRounds[i] = round;
+            ++takenAmount;
+            self->cpuIndices[workerIndex] = cpus[i].cpuIndex;
+            DEBUG_PRINT(
+                "worker %ld on cpu %d\n", workerIndex, cpus[i].cpuIndex
+            );
+            ++workerIndex;
+        }
+    }
+
+    free(takenRounds);
+    free(cpus);
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+void _workerPool_publishSense(
+    atomic_uint *flag,
+    atomic_uint *sleeperAmount,
+    unsigned int sense
+) {
+    DEBUG_ENTER_FUNC();
+    atomic_store(flag, sense);
+    if (atomic_load(sleeperAmount) > 0) {
+        syscall(
+            SYS_futex, (void*)flag, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0
+        );
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+// Returns once flag holds sense. The amount of polls adapts to how long
+// the waits usually take: it grows while the flag flips during polling and
+// shrinks while the thread ends up sleeping, so short iterations avoid the
+// futex and long ones do not burn a core.
+void _workerPool_awaitSense(
+    atomic_uint *flag,
+    atomic_uint *sleeperAmount,
+    unsigned int sense,
+    WorkerPoolWaiter *waiter
+) {
+    DEBUG_ENTER_FUNC();
+    for (unsigned int i = 0; i < waiter->spinCount; ++i) {
+        if (atomic_load_explicit(flag, memory_order_acquire) == sense) {
+            if (waiter->spinCount < WORKER_POOL_MAX_SPIN_COUNT) {
+                waiter->spinCount *= 2;
+            }
+            DEBUG_EXIT_FUNC();
+            return;
+        }
+        CPU_RELAX();
+    }
+    if (waiter->spinCount > WORKER_POOL_MIN_SPIN_COUNT) {
+        waiter->spinCount /= 2;
+    }
+
+    // the sleeper is registered before the flag is checked again, so either
+    // the flipping thread sees it or this thread sees the new sense
+    atomic_fetch_add(sleeperAmount, 1);
+    while (atomic_load(flag) != sense) {
+        syscall(
+            SYS_futex, (void*)flag, FUTEX_WAIT_PRIVATE, sense ^ 1,
+            NULL, NULL, 0
+        );
+    }
+    atomic_fetch_sub(sleeperAmount, 1);
+    DEBUG_EXIT_FUNC();
+}
 
 WorkerPool *workerPool_new(size_t workerAmount, bool lockCores) {
     DEBUG_ENTER_FUNC();
@@ -19,9 +334,16 @@ WorkerPool *workerPool_new(size_t workerAmount, bool lockCores) {
     }
 
     workerPool->workerAmount = workerAmount;
+    workerPool->activeWorkerAmount = workerAmount;
     workerPool->task = NULL;
     workerPool->argument = NULL;
     workerPool->lockCores = lockCores;
+    atomic_store(&(workerPool->isStopping), false);
+    workerPool->isBusy = false;
+    workerPool->runningTask = NULL;
+    workerPool->runningArgument = NULL;
+    const size_t coreAmount = workerPool_coreAmount();
+    _workerPool_waiterInitialize(&(workerPool->mainWaiter), coreAmount);
 
     workerPool->workers = (pthread_t*)calloc(workerAmount, sizeof(pthread_t));
     if (!workerPool->workers) {
@@ -40,35 +362,88 @@ WorkerPool *workerPool_new(size_t workerAmount, bool lockCores) {
         return NULL;
     }
 
-    int error = pthread_barrier_init(&(workerPool->barrier), NULL, workerAmount + 1);
-    if (error) {
+    // the flags are padded to whole cache lines and allocated on their own
+    const size_t syncSize = (
+        (sizeof(WorkerPoolSync) + WORKER_POOL_CACHE_LINE_SIZE - 1)
+        / WORKER_POOL_CACHE_LINE_SIZE * WORKER_POOL_CACHE_LINE_SIZE
+    );
+    workerPool->sync = (WorkerPoolSync*)aligned_alloc(
+        WORKER_POOL_CACHE_LINE_SIZE, syncSize
+    );
+    if (!workerPool->sync) {
         free(workerPool->workerFunctionContexts);
         free(workerPool->workers);
         free(workerPool);
-        PRINT_ERROR_WITH_NUMBER("error initializing workerPool->barrier", error);
+        PRINT_ERROR("error allocating workerPool->sync");
         DEBUG_EXIT_FUNC();
         return NULL;
     }
+    memset((void*)workerPool->sync, 0, syncSize);
 
-    sigemptyset(&(workerPool->signalSet));
-    sigaddset(&(workerPool->signalSet), WAKEUP_SIGNAL);
-    sigaddset(&(workerPool->signalSet), TERMINATION_SIGNAL);
-    error = pthread_sigmask(SIG_BLOCK, &(workerPool->signalSet), NULL);
-    if (error) {
-        pthread_barrier_destroy(&(workerPool->barrier));
+    workerPool->cpuIndices = (int*)malloc(workerAmount * sizeof(int));
+    if (!workerPool->cpuIndices) {
+        free(workerPool->sync);
         free(workerPool->workerFunctionContexts);
         free(workerPool->workers);
         free(workerPool);
-        PRINT_ERROR_WITH_NUMBER("error setting signal mask", error);
+        PRINT_ERROR("error allocating workerPool->cpuIndices");
         DEBUG_EXIT_FUNC();
         return NULL;
     }
+    if (lockCores && !_workerPool_placeWorkers(workerPool)) {
+        PRINT_ERROR("error reading the CPU topology, placing worker i on CPU i");
+        for (size_t i = 0; i < workerAmount; ++i) {
+            workerPool->cpuIndices[i] = (int)i;
+        }
+    }
+
+    workerPool->nodes = (int*)calloc(workerAmount, sizeof(int));
+    workerPool->nodeSlots = (size_t*)calloc(workerAmount, sizeof(size_t));
+    if (!workerPool->nodes || !workerPool->nodeSlots) {
+        free(workerPool->nodeSlots);
+        free(workerPool->nodes);
+        free(workerPool->cpuIndices);
+        free(workerPool->sync);
+        free(workerPool->workerFunctionContexts);
+        free(workerPool->workers);
+        free(workerPool);
+        PRINT_ERROR("error allocating workerPool->nodes");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    // only the nodes some worker runs on are listed, however sparse their
+    // ids are
+    workerPool->nodeAmount = lockCores ? 0 : 1;
+    for (size_t i = 0; lockCores && i < workerAmount; ++i) {
+        const int node = numaMemory_cpuNode(workerPool->cpuIndices[i]);
+        size_t slot = 0;
+        while (
+            slot < workerPool->nodeAmount && workerPool->nodes[slot] != node
+        ) {
+            ++slot;
+        }
+        if (slot == workerPool->nodeAmount) {
+            workerPool->nodes[workerPool->nodeAmount++] = node;
+        }
+        workerPool->nodeSlots[i] = slot;
+    }
+    atomic_store(&(workerPool->sync->remaining), 0);
+    atomic_store(&(workerPool->sync->taskSense), 0);
+    atomic_store(&(workerPool->sync->taskSleeperAmount), 0);
+    atomic_store(&(workerPool->sync->doneSense), 0);
+    atomic_store(&(workerPool->sync->doneSleeperAmount), 0);
+    atomic_store(&(workerPool->sync->activeWorkerAmount), workerAmount);
+    atomic_store(&(workerPool->sync->activation), 0);
+    atomic_store(&(workerPool->sync->activationSense), 0);
 
     for (size_t i = 0; i < workerAmount; ++i) {
         workerPool->workerFunctionContexts[i] = (WorkerFunctionContext){
             .workerPool = workerPool,
             .workerIndex = i
         };
+        _workerPool_waiterInitialize(
+            &(workerPool->workerFunctionContexts[i].waiter), coreAmount
+        );
     }
 
     DEBUG_EXIT_FUNC();
@@ -77,9 +452,14 @@ WorkerPool *workerPool_new(size_t workerAmount, bool lockCores) {
 
 void workerPool_delete(WorkerPool *self) {
     DEBUG_ENTER_FUNC();
-    pthread_barrier_destroy(&(self->barrier));
-    free(self->workerFunctionContexts);
-    free(self->workers);
+    if (self) {
+        free(self->nodeSlots);
+        free(self->nodes);
+        free(self->cpuIndices);
+        free(self->sync);
+        free(self->workerFunctionContexts);
+        free(self->workers);
+    }
     free(self);
     DEBUG_EXIT_FUNC();
 }
@@ -96,17 +476,46 @@ void workerPool_setArgument(WorkerPool *self, void *argument) {
     DEBUG_EXIT_FUNC();
 }
 
+// Sleeps until the worker is active again and returns the task sense to
+// continue from, or returns false once the pool stops.
+bool _workerPool_park(
+    WorkerPool *self,
+    size_t workerIndex,
+    unsigned int activation,
+    WorkerPoolWaiter *waiter
+) {
+    DEBUG_ENTER_FUNC();
+    WorkerPoolSync *sync = self->sync;
+    while (workerIndex >= atomic_load(&(sync->activeWorkerAmount))) {
+        if (atomic_load(&(self->isStopping))) {
+            DEBUG_EXIT_FUNC();
+            return false;
+        }
+        syscall(
+            SYS_futex, (void*)&(sync->activation), FUTEX_WAIT_PRIVATE,
+            activation, NULL, NULL, 0
+        );
+        activation = atomic_load(&(sync->activation));
+    }
+    // the active amount only grows while no task runs, and the next task
+    // can not finish without this worker, so it is at most one flip ahead
+    waiter->sense = atomic_load(&(sync->activationSense));
+    DEBUG_EXIT_FUNC();
+    return !atomic_load(&(self->isStopping));
+}
+
 void * _workerPool_workerFunction(void *context) {
     DEBUG_ENTER_FUNC();
     WorkerPool *self = ((WorkerFunctionContext*)context)->workerPool;
     size_t workerIndex = ((WorkerFunctionContext*)context)->workerIndex;
+    WorkerPoolWaiter *waiter = &(((WorkerFunctionContext*)context)->waiter);
 
     if (self->lockCores) {
         cpu_set_t cpuSet;
         CPU_ZERO(&cpuSet);
-        CPU_SET(workerIndex, &cpuSet);
+        CPU_SET(self->cpuIndices[workerIndex], &cpuSet);
         int error = pthread_setaffinity_np(
-            self->workers[workerIndex],
+            pthread_self(),
             sizeof(cpu_set_t),
             &cpuSet
         );
@@ -117,25 +526,36 @@ void * _workerPool_workerFunction(void *context) {
         }
     }
 
-    int signal = 0;
+    WorkerPoolSync *sync = self->sync;
     while (true) {
-        int error = sigwait(&(self->signalSet), &signal);
-        if (error) {
-            PRINT_ERROR_WITH_NUMBER("error waiting for signal", error);
+        const unsigned int sense = waiter->sense ^ 1;
+        waiter->sense = sense;
+        _workerPool_awaitSense(
+            &(sync->taskSense), &(sync->taskSleeperAmount), sense, waiter
+        );
+        if (atomic_load(&(self->isStopping))) {
             DEBUG_EXIT_FUNC();
-            EXIT(EXIT_FAILURE);
+            return NULL;
         }
-        switch (signal) {
-            case WAKEUP_SIGNAL:
-                self->task(self->argument, workerIndex, self->workerAmount);
-                printf("Task Done\n");
-                break;
-            case TERMINATION_SIGNAL:
-                DEBUG_EXIT_FUNC();
-                return NULL;
+        // the active amount can not change before this task is done
+        const size_t activeWorkerAmount = atomic_load(
+            &(sync->activeWorkerAmount)
+        );
+        const unsigned int activation = atomic_load(&(sync->activation));
+        self->runningTask(self->runningArgument, workerIndex, activeWorkerAmount);
+        DEBUG_PRINT("task done %ld\n", workerIndex);
+        if (atomic_fetch_sub(&(sync->remaining), 1) == 1) {
+            _workerPool_publishSense(
+                &(sync->doneSense), &(sync->doneSleeperAmount), sense
+            );
+        }
+        if (
+            workerIndex >= activeWorkerAmount
+            && !_workerPool_park(self, workerIndex, activation, waiter)
+        ) {
+            DEBUG_EXIT_FUNC();
+            return NULL;
         }
-        DEBUG_PRINT("encountered barrier %ld\n", workerIndex);
-        pthread_barrier_wait(&(self->barrier));
     }
 
     DEBUG_EXIT_FUNC();
@@ -160,39 +580,253 @@ void workerPool_start(WorkerPool *self) {
     DEBUG_EXIT_FUNC();
 }
 
-void workerPool_runTask(WorkerPool *self) {
+void _workerPool_start(WorkerPool *self, Task task, void *argument) {
     DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(!self->isBusy, "the pool runs one task at a time.");
     DEBUG_ENTER_WORKER_MODE();
-    for (size_t i = 0; i < self->workerAmount; ++i) {
-        int error = pthread_kill(self->workers[i], WAKEUP_SIGNAL);
-        if (error) {
-            PRINT_ERROR_WITH_NUMBER("error sending WAKEUP_SIGNAL", error);
-            DEBUG_ENTER_MAIN_THREAD_MODE();
-            DEBUG_EXIT_FUNC();
-            EXIT(EXIT_FAILURE);
+    self->isBusy = true;
+    self->runningTask = task;
+    self->runningArgument = argument;
+    WorkerPoolSync *sync = self->sync;
+    const unsigned int sense = self->mainWaiter.sense ^ 1;
+    self->mainWaiter.sense = sense;
+    atomic_store(&(sync->remaining), self->activeWorkerAmount);
+    _workerPool_publishSense(
+        &(sync->taskSense), &(sync->taskSleeperAmount), sense
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+void _workerPool_wait(WorkerPool *self) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(self->isBusy, "no task to wait for.");
+    _workerPool_awaitSense(
+        &(self->sync->doneSense), &(self->sync->doneSleeperAmount),
+        self->mainWaiter.sense, &(self->mainWaiter)
+    );
+    self->isBusy = false;
+    DEBUG_ENTER_MAIN_THREAD_MODE();
+    DEBUG_EXIT_FUNC();
+}
+
+void workerPool_runTask(WorkerPool *self) {
+    DEBUG_ENTER_FUNC();
+    _workerPool_start(self, self->task, self->argument);
+    _workerPool_wait(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void _workerPool_rangeTask(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    WorkerPoolRange *range = (WorkerPoolRange*)argument;
+    while (true) {
+        const size_t begin = atomic_fetch_add_explicit(
+            &(range->cursor), range->grain, memory_order_relaxed
+        );
+        if (begin >= range->end) {
+            break;
         }
+        const size_t end = (
+            range->end - begin < range->grain ? range->end : begin + range->grain
+        );
+        range->task(range->argument, begin, end, workerIndex);
     }
-    int error = pthread_barrier_wait(&(self->barrier));
-    if (error) {
-        PRINT_ERROR_WITH_NUMBER("error waiting for barrier in main thread", error);
-        DEBUG_ENTER_MAIN_THREAD_MODE();
+    DEBUG_EXIT_FUNC();
+}
+
+void workerPool_parallelFor(
+    WorkerPool *self,
+    size_t begin,
+    size_t end,
+    size_t grain,
+    RangeTask task,
+    void *argument
+) {
+    DEBUG_ENTER_FUNC();
+    if (begin >= end) {
         DEBUG_EXIT_FUNC();
-        EXIT(EXIT_FAILURE);
+        return;
     }
-    DEBUG_ENTER_MAIN_THREAD_MODE();
+    WorkerPoolRange range = {
+        .task = task,
+        .argument = argument,
+        .begin = begin,
+        .end = end,
+        .grain = grain > 0 ? grain : 1
+    };
+    atomic_store_explicit(&(range.cursor), begin, memory_order_relaxed);
+    _workerPool_start(self, _workerPool_rangeTask, (void*)&range);
+    _workerPool_wait(self);
     DEBUG_EXIT_FUNC();
 }
 
-void workerPool_stop(WorkerPool *self) {
+WorkerPoolTaskGroup * workerPoolTaskGroup_new(size_t capacity) {
     DEBUG_ENTER_FUNC();
-    for (size_t i = 0; i < self->workerAmount; ++i) {
-        int error = pthread_kill(self->workers[i], TERMINATION_SIGNAL);
-        if (error) {
-            PRINT_ERROR_WITH_NUMBER("error sending TERMINATION_SIGNAL", error);
-            DEBUG_EXIT_FUNC();
-            EXIT(EXIT_FAILURE);
+    WorkerPoolTaskGroup *group = (WorkerPoolTaskGroup*)malloc(
+        sizeof(WorkerPoolTaskGroup)
+    );
+    if (!group) {
+        PRINT_ERROR("error allocating group");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+
+    group->jobs = (WorkerPoolJob*)malloc(capacity * sizeof(WorkerPoolJob));
+    if (!group->jobs) {
+        free(group);
+        PRINT_ERROR("error allocating group->jobs");
+        DEBUG_EXIT_FUNC();
+        return NULL;
+    }
+    group->jobAmount = 0;
+    group->capacity = capacity;
+    atomic_store_explicit(&(group->cursor), 0, memory_order_relaxed);
+
+    DEBUG_EXIT_FUNC();
+    return group;
+}
+
+void workerPoolTaskGroup_delete(WorkerPoolTaskGroup *self) {
+    DEBUG_ENTER_FUNC();
+    if (self) {
+        free(self->jobs);
+    }
+    free(self);
+    DEBUG_EXIT_FUNC();
+}
+
+bool workerPoolTaskGroup_add(
+    WorkerPoolTaskGroup *self,
+    Task task,
+    void *argument
+) {
+    DEBUG_ENTER_FUNC();
+    if (self->jobAmount == self->capacity) {
+        errno = ENOBUFS;
+        PRINT_ERROR("task group is full");
+        DEBUG_EXIT_FUNC();
+        return false;
+    }
+    self->jobs[self->jobAmount++] = (WorkerPoolJob){
+        .task = task,
+        .argument = argument
+    };
+    DEBUG_EXIT_FUNC();
+    return true;
+}
+
+void workerPoolTaskGroup_clear(WorkerPoolTaskGroup *self) {
+    DEBUG_ENTER_FUNC();
+    self->jobAmount = 0;
+    DEBUG_EXIT_FUNC();
+}
+
+void _workerPool_taskGroupTask(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    WorkerPoolTaskGroup *group = (WorkerPoolTaskGroup*)argument;
+    while (true) {
+        const size_t jobIndex = atomic_fetch_add_explicit(
+            &(group->cursor), 1, memory_order_relaxed
+        );
+        if (jobIndex >= group->jobAmount) {
+            break;
         }
+        const WorkerPoolJob *job = &(group->jobs[jobIndex]);
+        job->task(job->argument, workerIndex, workerAmount);
+    }
+    DEBUG_EXIT_FUNC();
+}
+
+void workerPool_startTaskGroup(WorkerPool *self, WorkerPoolTaskGroup *group) {
+    DEBUG_ENTER_FUNC();
+    atomic_store_explicit(&(group->cursor), 0, memory_order_relaxed);
+    _workerPool_start(self, _workerPool_taskGroupTask, (void*)group);
+    DEBUG_EXIT_FUNC();
+}
+
+void workerPool_waitTaskGroup(WorkerPool *self, WorkerPoolTaskGroup *group) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(
+        self->runningArgument == (void*)group,
+        "the group has to be the one started last."
+    );
+    _workerPool_wait(self);
+    DEBUG_EXIT_FUNC();
+}
+
+void workerPool_runTaskGroup(WorkerPool *self, WorkerPoolTaskGroup *group) {
+    DEBUG_ENTER_FUNC();
+    workerPool_startTaskGroup(self, group);
+    workerPool_waitTaskGroup(self, group);
+    DEBUG_EXIT_FUNC();
+}
+
+void _workerPool_noTask(
+    void *argument,
+    size_t workerIndex,
+    size_t workerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_EXIT_FUNC();
+}
+
+void _workerPool_wakeParked(WorkerPool *self) {
+    DEBUG_ENTER_FUNC();
+    atomic_fetch_add(&(self->sync->activation), 1);
+    syscall(
+        SYS_futex, (void*)&(self->sync->activation), FUTEX_WAKE_PRIVATE,
+        INT_MAX, NULL, NULL, 0
+    );
+    DEBUG_EXIT_FUNC();
+}
+
+void workerPool_setActiveWorkerAmount(
+    WorkerPool *self,
+    size_t activeWorkerAmount
+) {
+    DEBUG_ENTER_FUNC();
+    DEBUG_ASSERT(!self->isBusy, "the active amount changes between tasks.");
+    if (activeWorkerAmount < 1) {
+        activeWorkerAmount = 1;
     }
+    if (activeWorkerAmount > self->workerAmount) {
+        activeWorkerAmount = self->workerAmount;
+    }
+    WorkerPoolSync *sync = self->sync;
+    if (activeWorkerAmount < self->activeWorkerAmount) {
+        // the workers that drop out wait for tasks, an empty one still
+        // counting them sends them to sleep on activation instead
+        atomic_store(&(sync->activeWorkerAmount), activeWorkerAmount);
+        _workerPool_start(self, _workerPool_noTask, NULL);
+        _workerPool_wait(self);
+    } else if (activeWorkerAmount > self->activeWorkerAmount) {
+        atomic_store(&(sync->activationSense), self->mainWaiter.sense);
+        atomic_store(&(sync->activeWorkerAmount), activeWorkerAmount);
+        _workerPool_wakeParked(self);
+    }
+    self->activeWorkerAmount = activeWorkerAmount;
+    DEBUG_EXIT_FUNC();
+}
+
+void workerPool_stop(WorkerPool *self) {
+    DEBUG_ENTER_FUNC();
+    // the workers see isStopping once the task flag flips, parked ones
+    // once activation changes
+    atomic_store(&(self->isStopping), true);
+    const unsigned int sense = self->mainWaiter.sense ^ 1;
+    self->mainWaiter.sense = sense;
+    _workerPool_publishSense(
+        &(self->sync->taskSense), &(self->sync->taskSleeperAmount), sense
+    );
+    _workerPool_wakeParked(self);
     for (size_t i = 0; i < self->workerAmount; ++i) {
         int error = pthread_join(self->workers[i], NULL);
         if (error) {
@@ -206,7 +840,19 @@ void workerPool_stop(WorkerPool *self) {
 
 size_t workerPool_coreAmount(void) {
     DEBUG_ENTER_FUNC();
-    size_t result = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t cpuSet;
+    size_t result = (
+        sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet) == 0
+        ? (size_t)CPU_COUNT(&cpuSet)
+        : (size_t)sysconf(_SC_NPROCESSORS_ONLN)
+    );
+    const size_t quotaCpuAmount = _workerPool_quotaCpuAmount();
+    if (quotaCpuAmount > 0 && quotaCpuAmount < result) {
+        result = quotaCpuAmount;
+    }
+    if (result == 0) {
+        result = 1;
+    }
     DEBUG_EXIT_FUNC();
     return result;
 }
\ No newline at end of file
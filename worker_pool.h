@@ -3,9 +3,37 @@
 
 #define _GNU_SOURCE
 #include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
-#include <signal.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+
+#ifndef WORKER_POOL_CACHE_LINE_SIZE
+#define WORKER_POOL_CACHE_LINE_SIZE (64)
+#endif // WORKER_POOL_CACHE_LINE_SIZE
+
+// bounds of the adaptive amount of polls before a waiting thread sleeps
+#ifndef WORKER_POOL_MIN_SPIN_COUNT
+#define WORKER_POOL_MIN_SPIN_COUNT (16)
+#endif // WORKER_POOL_MIN_SPIN_COUNT
+
+#ifndef WORKER_POOL_MAX_SPIN_COUNT
+#define WORKER_POOL_MAX_SPIN_COUNT (2048)
+#endif // WORKER_POOL_MAX_SPIN_COUNT
+
+// Output of benchmark/benchmark.c, fastest core first. If it exists,
+// workers are placed on the fastest cores first.
+#ifndef WORKER_POOL_CORE_RANKING_FILE
+#define WORKER_POOL_CORE_RANKING_FILE "core_ranking.txt"
+#endif // WORKER_POOL_CORE_RANKING_FILE
+
+#ifndef WORKER_POOL_CPU_DIRECTORY
+#define WORKER_POOL_CPU_DIRECTORY "/sys/devices/system/cpu"
+#endif // WORKER_POOL_CPU_DIRECTORY
+
+#ifndef WORKER_POOL_CGROUP_DIRECTORY
+#define WORKER_POOL_CGROUP_DIRECTORY "/sys/fs/cgroup"
+#endif // WORKER_POOL_CGROUP_DIRECTORY
 
 typedef void (*Task)(
     void *argument,
@@ -13,24 +41,110 @@ typedef void (*Task)(
     size_t workerAmount
 );
 
+// runs the indices begin .. end - 1 of a parallel for
+typedef void (*RangeTask)(
+    void *argument,
+    size_t begin,
+    size_t end,
+    size_t workerIndex
+);
+
 typedef struct WorkerPool WorkerPool;
 
+// A task with its own argument. Within a task group workerAmount is the
+// amount of workers of the pool, workerIndex the one running the job.
+typedef struct {
+    Task task;
+    void *argument;
+} WorkerPoolJob;
+
+// Jobs that are claimed by the workers one at a time until all are done.
+typedef struct {
+    WorkerPoolJob *jobs;
+    size_t jobAmount;
+    size_t capacity;
+    atomic_size_t cursor;
+} WorkerPoolTaskGroup;
+
+// the state of one parallel for, claimed in chunks of grain indices
+typedef struct {
+    RangeTask task;
+    void *argument;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    atomic_size_t cursor;
+} WorkerPoolRange;
+
+// Hands tasks to the workers and reports their completion with two
+// sense reversing flags. The main thread starts a task by flipping
+// taskSense; the last worker to finish it flips doneSense. Waiting threads
+// poll their flag for a while and then sleep on it with a futex, and the
+// flipping thread only issues a wake up if someone sleeps. Workers beyond
+// activeWorkerAmount do not wait for tasks at all; they sleep on
+// activation, which counts the changes of the active amount, and resume
+// with the task sense of activationSense. remaining gets
+// a cache line of its own, so finishing workers do not disturb the polling
+// threads. All padding is explicit, so the layout does not depend on
+// whether a packing pragma of another header is in effect.
+typedef struct {
+    atomic_uint remaining;
+    uint8_t remainingPadding[WORKER_POOL_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+    atomic_uint taskSense;
+    atomic_uint taskSleeperAmount;
+    atomic_uint doneSense;
+    atomic_uint doneSleeperAmount;
+    atomic_uint activeWorkerAmount;
+    atomic_uint activation;
+    atomic_uint activationSense;
+} WorkerPoolSync;
+
+// state every thread keeps for itself while waiting for a flag
+typedef struct {
+    unsigned int sense;
+    unsigned int spinCount;
+} WorkerPoolWaiter;
+
 typedef struct {
     WorkerPool *workerPool;
     size_t workerIndex;
+    WorkerPoolWaiter waiter;
 } WorkerFunctionContext;
 
+// an allowed CPU with its physical core and its place in the core ranking
+typedef struct {
+    int cpuIndex;
+    int rank;
+    long packageId;
+    long coreId;
+} WorkerPoolCpu;
+
 struct WorkerPool {
     size_t workerAmount;
+    size_t activeWorkerAmount;
     Task task;
     void *argument;
+    Task runningTask;
+    void *runningArgument;
     pthread_t *workers;
-    pthread_barrier_t barrier;
-    sigset_t signalSet;
+    int *cpuIndices;
+    // the distinct memory nodes of the workers in the order of their first
+    // worker, and per worker its slot in that list; unlocked workers all
+    // share the one slot of node 0
+    int *nodes;
+    size_t nodeAmount;
+    size_t *nodeSlots;
+    WorkerPoolSync *sync;
+    WorkerPoolWaiter mainWaiter;
     WorkerFunctionContext *workerFunctionContexts;
     bool lockCores;
+    atomic_bool isStopping;
+    bool isBusy;
 };
 
+// Locked workers are placed on the CPUs of the affinity mask, one per
+// physical core in the order of the core ranking first, and only then on
+// the remaining hardware threads.
 WorkerPool *workerPool_new(size_t workerAmount, bool lockCores);
 void workerPool_delete(WorkerPool *self);
 
@@ -41,6 +155,42 @@ void workerPool_start(WorkerPool *self);
 void workerPool_runTask(WorkerPool *self);
 void workerPool_stop(WorkerPool *self);
 
+// Lets only the workers 0 .. activeWorkerAmount - 1 run the following
+// tasks, the others sleep without being woken up. Tasks see the active
+// amount as their workerAmount. Must not be called while a task runs.
+void workerPool_setActiveWorkerAmount(
+    WorkerPool *self,
+    size_t activeWorkerAmount
+);
+
+// Calls task for chunks of up to grain indices of begin .. end - 1 on all
+// workers and returns when the whole range is done.
+void workerPool_parallelFor(
+    WorkerPool *self,
+    size_t begin,
+    size_t end,
+    size_t grain,
+    RangeTask task,
+    void *argument
+);
+
+WorkerPoolTaskGroup * workerPoolTaskGroup_new(size_t capacity);
+void workerPoolTaskGroup_delete(WorkerPoolTaskGroup *self);
+bool workerPoolTaskGroup_add(
+    WorkerPoolTaskGroup *self,
+    Task task,
+    void *argument
+);
+void workerPoolTaskGroup_clear(WorkerPoolTaskGroup *self);
+
+// Starts the jobs of group and returns right away, so the calling thread
+// can do other work until workerPool_waitTaskGroup. Only one task, task
+// group or parallel for runs on a pool at a time.
+void workerPool_startTaskGroup(WorkerPool *self, WorkerPoolTaskGroup *group);
+void workerPool_waitTaskGroup(WorkerPool *self, WorkerPoolTaskGroup *group);
+void workerPool_runTaskGroup(WorkerPool *self, WorkerPoolTaskGroup *group);
+
+// the CPUs of the affinity mask, limited by the cgroup CPU quota
 size_t workerPool_coreAmount(void);
 
 #endif // __WORKER_POOL_H__